@@ -1,2 +1,143 @@
-﻿// See https://aka.ms/new-console-template for more information
-Console.WriteLine("Hello, World!");
+using System.Diagnostics;
+using System.Runtime;
+
+namespace DotnetTest;
+
+// Workload suite for measuring tracer overhead. Each scenario prints one machine-readable
+// RESULT line; overhead.sh / overhead.ps1 run it with and without the profiler and compare.
+// jitMs is process-wide, so with one scenario per process it is that scenario's JIT cost.
+// memGrowthKB is the working set change over the timed iterations; it should stay near zero
+// for steady-state scenarios. Scenarios with a growth limit (alc-reload) also print a LEAKCHECK
+// line for the second half of the iterations, once JIT and allocator warm-up is over, and fail
+// the run when it grows faster than the limit.
+//
+//   DotnetTest [scenario ...] [--iterations N] [--warmup N] [--check-stack]
+static class Program
+{
+    record Scenario(string Name, Func<long> Iteration, Action? StackCheck, double? MaxGrowthKBPerIteration = null);
+
+    // Too few iterations and the allocator's step size dominates the per-iteration figure.
+    const int MinLeakCheckIterations = 200;
+    static int s_leakFailures;
+
+    static readonly Scenario[] Scenarios =
+    [
+        new("recursion", () => Workloads.DeepRecursion(null), () => Workloads.DeepRecursion(_ => ShadowStackCheck.Verify("recursion"))),
+        new("small-methods", Workloads.SmallMethods, null),
+        new("generics", () => Workloads.Generics(null), () => Workloads.Generics(_ => ShadowStackCheck.Verify("generics"))),
+        new("async", Workloads.AsyncAwait, null),
+        new("threadpool", Workloads.ThreadPoolFanOut, null),
+        new("pinvoke", Workloads.PInvoke, null),
+        new("exceptions", Workloads.Exceptions, null),
+        // Unprofiled, the runtime itself stays under about 1 KB per reload; a tracer that keeps
+        // the evicted symbols of each unloaded copy adds several times that.
+        new("alc-reload", Workloads.CollectibleReload, null, MaxGrowthKBPerIteration: 4),
+    ];
+
+    static int Main(string[] args)
+    {
+        int iterations = 200;
+        int warmup = 20;
+        bool checkStack = false;
+        var selected = new List<Scenario>();
+
+        for (int i = 0; i < args.Length; i++)
+        {
+            switch (args[i])
+            {
+            case "--iterations":
+                iterations = int.Parse(args[++i]);
+                break;
+            case "--warmup":
+                warmup = int.Parse(args[++i]);
+                break;
+            case "--check-stack":
+                checkStack = true;
+                break;
+            case "--list":
+                foreach (var s in Scenarios)
+                    Console.WriteLine(s.Name);
+                return 0;
+            default:
+                var scenario = Scenarios.FirstOrDefault(s => s.Name == args[i]);
+                if (scenario == null)
+                {
+                    Console.Error.WriteLine($"unknown scenario '{args[i]}'; use --list");
+                    return 2;
+                }
+                selected.Add(scenario);
+                break;
+            }
+        }
+
+        if (selected.Count == 0)
+            selected.AddRange(Scenarios);
+
+        ThreadPool.SetMinThreads(Math.Max(Environment.ProcessorCount, 16), Math.Max(Environment.ProcessorCount, 16));
+
+        foreach (var scenario in selected)
+        {
+            Run(scenario, iterations, warmup);
+            // Checked after timing so the dump never lands inside a measured iteration.
+            if (checkStack && scenario.StackCheck != null)
+                scenario.StackCheck();
+        }
+
+        if (checkStack && !ShadowStackCheck.Available)
+            Console.WriteLine("STACKCHECK skipped: profiler not loaded or SW2TracerDump not exported");
+
+        return ShadowStackCheck.Failures == 0 && s_leakFailures == 0 ? 0 : 1;
+    }
+
+    static void Run(Scenario scenario, int iterations, int warmup)
+    {
+        for (int i = 0; i < warmup; i++)
+            scenario.Iteration();
+
+        long workingSetBefore = Environment.WorkingSet;
+        long workingSetHalfway = workingSetBefore;
+        var latencies = new double[iterations];
+        long ops = 0;
+        var total = Stopwatch.StartNew();
+        for (int i = 0; i < iterations; i++)
+        {
+            if (i == iterations / 2)
+                workingSetHalfway = Environment.WorkingSet;
+            long start = Stopwatch.GetTimestamp();
+            ops += scenario.Iteration();
+            latencies[i] = Stopwatch.GetElapsedTime(start).TotalMicroseconds;
+        }
+        total.Stop();
+        long workingSetAfter = Environment.WorkingSet;
+        long memGrowthKB = (workingSetAfter - workingSetBefore) / 1024;
+
+        Array.Sort(latencies);
+        double seconds = total.Elapsed.TotalSeconds;
+        Console.WriteLine(FormattableString.Invariant(
+            $"RESULT scenario={scenario.Name} iterations={iterations} ops={ops} seconds={seconds:F4} opsPerSec={ops / seconds:F0} p50Us={Percentile(latencies, 0.50):F1} p99Us={Percentile(latencies, 0.99):F1} jitMs={JitInfo.GetCompilationTime().TotalMilliseconds:F1} jitMethods={JitInfo.GetCompiledMethodCount()} memGrowthKB={memGrowthKB}"));
+
+        if (scenario.MaxGrowthKBPerIteration is double limit)
+        {
+            if (iterations < MinLeakCheckIterations)
+            {
+                Console.WriteLine($"LEAKCHECK scenario={scenario.Name} skipped: needs --iterations {MinLeakCheckIterations} or more");
+                return;
+            }
+            int measured = iterations - iterations / 2;
+            double perIteration = (workingSetAfter - workingSetHalfway) / 1024.0 / measured;
+            bool ok = perIteration <= limit;
+            Console.WriteLine(FormattableString.Invariant(
+                $"LEAKCHECK scenario={scenario.Name} iterations={measured} growthKBPerIteration={perIteration:F2} limit={limit:F2} ok={ok}"));
+            if (!ok)
+                s_leakFailures++;
+        }
+    }
+
+    static double Percentile(double[] sorted, double fraction)
+    {
+        if (sorted.Length == 0)
+            return 0;
+        int index = (int)Math.Ceiling(fraction * sorted.Length) - 1;
+        return sorted[Math.Clamp(index, 0, sorted.Length - 1)];
+    }
+}
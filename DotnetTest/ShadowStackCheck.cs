@@ -0,0 +1,153 @@
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Text.RegularExpressions;
+
+namespace DotnetTest;
+
+// Compares the tracer's shadow stack for the calling thread (via the SW2TracerDump export)
+// with Environment.StackTrace. Only frames from this assembly are compared, by simple method
+// name and in order, so runtime helpers and JIT-internal frames don't cause false alarms.
+static unsafe class ShadowStackCheck
+{
+    static delegate* unmanaged<byte*, void> s_dump;
+    static bool s_resolved;
+
+    public static bool Available
+    {
+        get
+        {
+            if (!s_resolved)
+            {
+                s_resolved = true;
+                var path = Environment.GetEnvironmentVariable("CORECLR_PROFILER_PATH");
+                if (Environment.GetEnvironmentVariable("CORECLR_ENABLE_PROFILING") == "1" &&
+                    !string.IsNullOrEmpty(path) &&
+                    NativeLibrary.TryLoad(path, out var handle) &&
+                    NativeLibrary.TryGetExport(handle, "SW2TracerDump", out var export))
+                {
+                    s_dump = (delegate* unmanaged<byte*, void>)export;
+                }
+            }
+            return s_dump != null;
+        }
+    }
+
+    public static int Failures { get; private set; }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    public static void Verify(string scenario)
+    {
+        if (!Available)
+            return;
+
+        var expected = ManagedFrames(Environment.StackTrace);
+        var path = Path.Combine(Path.GetTempPath(), $"sw2tracer-stackcheck-{Environment.ProcessId}.txt");
+        InvokeDump(path);
+        var shadow = ShadowFrames(File.ReadAllLines(path));
+        File.Delete(path);
+
+        bool ok = shadow != null && shadow.SequenceEqual(expected);
+        Console.WriteLine($"STACKCHECK scenario={scenario} expected={expected.Count} shadow={shadow?.Count ?? -1} ok={ok}");
+        if (!ok)
+        {
+            Failures++;
+            Console.WriteLine($"    expected: {string.Join(" <- ", expected.Take(12))}");
+            Console.WriteLine($"    shadow  : {(shadow == null ? "(calling thread not found in dump)" : string.Join(" <- ", shadow.Take(12)))}");
+        }
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static void InvokeDump(string path)
+    {
+        var bytes = System.Text.Encoding.UTF8.GetBytes(path + "\0");
+        fixed (byte* p = bytes)
+            s_dump(p);
+    }
+
+    // "   at DotnetTest.Workloads.Recurse(Int32 depth, Action`1 atBottom) in ..." -> "Recurse"
+    static List<string> ManagedFrames(string stackTrace)
+    {
+        var frames = new List<string>();
+        foreach (var raw in stackTrace.Split('\n'))
+        {
+            var line = raw.Trim();
+            if (!line.StartsWith("at "))
+                continue;
+            int paren = line.IndexOf('(');
+            var qualified = paren < 0 ? line[3..] : line[3..paren];
+            int generic = qualified.IndexOf('[');
+            if (generic >= 0)
+                qualified = qualified[..generic];
+            AddIfOurs(frames, qualified);
+        }
+        return frames;
+    }
+
+    // Thread blocks in the dump list frames innermost first, each starting with its signature
+    // line, e.g. "    long DotnetTest.Workloads.Recurse(int depth, ...)". The calling thread is
+    // the one currently inside InvokeDump. Folded recursion is expanded back: a signature
+    // ending in " xN" stands for N frames.
+    static List<string>? ShadowFrames(string[] dump)
+    {
+        List<string>? current = null;
+        bool isCaller = false;
+        bool expectSignature = false;
+        foreach (var line in dump)
+        {
+            // Unindented lines start a thread block or one of the trailing summary sections.
+            if (line.Length > 0 && !char.IsWhiteSpace(line[0]))
+            {
+                if (isCaller)
+                    return Ours(current!);
+                current = line.StartsWith("Thread ") ? new List<string>() : null;
+                expectSignature = true;
+                continue;
+            }
+            if (current == null)
+                continue;
+            if (line.Length == 0)
+            {
+                expectSignature = true;
+                continue;
+            }
+            if (!expectSignature || !line.StartsWith("    ") || line.StartsWith("        "))
+                continue;
+
+            expectSignature = false;
+            var signature = line.Trim();
+            if (signature.StartsWith('('))
+                continue;
+
+            int copies = 1;
+            var folded = Regex.Match(signature, @" x(\d+)$");
+            if (folded.Success)
+            {
+                copies = int.Parse(folded.Groups[1].Value);
+                signature = signature[..folded.Index];
+            }
+            int paren = signature.IndexOf('(');
+            var qualified = paren < 0 ? signature : signature[..paren];
+            if (qualified.EndsWith("ShadowStackCheck.InvokeDump"))
+                isCaller = true;
+            for (int i = 0; i < copies; i++)
+                current.Add(qualified);
+        }
+        return isCaller ? Ours(current!) : null;
+    }
+
+    static List<string> Ours(List<string> qualifiedNames)
+    {
+        var frames = new List<string>();
+        foreach (var qualified in qualifiedNames)
+            AddIfOurs(frames, qualified);
+        return frames;
+    }
+
+    static void AddIfOurs(List<string> frames, string qualified)
+    {
+        if (!qualified.Contains("DotnetTest.") || qualified.Contains("ShadowStackCheck."))
+            return;
+        int dot = qualified.LastIndexOf('.');
+        frames.Add(dot < 0 ? qualified : qualified[(dot + 1)..]);
+    }
+}
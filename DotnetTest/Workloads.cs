@@ -0,0 +1,251 @@
+using System.Numerics;
+using System.Reflection;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Loader;
+
+namespace DotnetTest;
+
+// Each workload runs one iteration and returns how many "operations" (mostly managed calls)
+// it performed, so throughput is comparable with and without the profiler attached.
+// NoInlining keeps the call shape identical in both runs; the tracer's ELT hooks would
+// otherwise see different frames depending on JIT decisions.
+static class Workloads
+{
+    public const int RecursionDepth = 2000;
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    public static long Recurse(int depth, Action<int>? atBottom)
+    {
+        if (depth == 0)
+        {
+            atBottom?.Invoke(RecursionDepth);
+            return 1;
+        }
+        return Recurse(depth - 1, atBottom) + 1;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    public static long Fib(int n) => n < 2 ? n : Fib(n - 1) + Fib(n - 2);
+
+    public static long DeepRecursion(Action<int>? atBottom)
+    {
+        long calls = Recurse(RecursionDepth, atBottom);
+        // Fib(18) makes 8361 calls with a shallow, wide shape.
+        Fib(18);
+        return calls + 8361;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static int Add(int a, int b) => a + b;
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static int Mix(int a) => (a * 31) ^ (a >> 3);
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static bool IsOdd(int a) => (a & 1) != 0;
+
+    public static long SmallMethods()
+    {
+        const int n = 50_000;
+        int acc = 0;
+        for (int i = 0; i < n; i++)
+        {
+            acc = Add(acc, Mix(i));
+            if (IsOdd(acc))
+                acc = Add(acc, 1);
+        }
+        GC.KeepAlive(acc);
+        return n * 2 + n / 2;
+    }
+
+    sealed class Box<T>
+    {
+        public T Value;
+        public Box(T value) => Value = value;
+
+        [MethodImpl(MethodImplOptions.NoInlining)]
+        public TResult Map<TResult>(Func<T, TResult> f) => f(Value);
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static T Sum<T>(IReadOnlyList<T> values) where T : INumber<T>
+    {
+        T total = T.Zero;
+        for (int i = 0; i < values.Count; i++)
+            total += values[i];
+        return total;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static TValue GetOrAdd<TKey, TValue>(Dictionary<TKey, TValue> map, TKey key, Func<TKey, TValue> factory) where TKey : notnull
+    {
+        if (!map.TryGetValue(key, out var value))
+        {
+            value = factory(key);
+            map[key] = value;
+        }
+        return value;
+    }
+
+    static readonly int[] Ints = Enumerable.Range(0, 64).ToArray();
+    static readonly long[] Longs = Enumerable.Range(0, 64).Select(i => (long)i).ToArray();
+    static readonly double[] Doubles = Enumerable.Range(0, 64).Select(i => i * 0.5).ToArray();
+
+    public static long Generics(Action<int>? checkpoint)
+    {
+        const int rounds = 500;
+        var byString = new Dictionary<string, Box<int>>();
+        var byInt = new Dictionary<int, Box<string>>();
+        long ops = 0;
+        for (int i = 0; i < rounds; i++)
+        {
+            Sum<int>(Ints);
+            Sum<long>(Longs);
+            Sum<double>(Doubles);
+            var boxed = GetOrAdd(byString, (i & 31).ToString(), k => new Box<int>(k.Length));
+            var text = GetOrAdd(byInt, i & 31, k => new Box<string>(k.ToString()));
+            boxed.Map(v => v * 2);
+            text.Map(s => s.Length);
+            ops += 9;
+        }
+        checkpoint?.Invoke(0);
+        return ops;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static async Task<int> AsyncChain(int depth)
+    {
+        if (depth == 0)
+        {
+            await Task.Yield();
+            return 1;
+        }
+        return await AsyncChain(depth - 1) + 1;
+    }
+
+    public static long AsyncAwait()
+    {
+        const int chains = 200;
+        const int depth = 10;
+        var tasks = new Task<int>[chains];
+        for (int i = 0; i < chains; i++)
+            tasks[i] = AsyncChain(depth);
+        Task.WaitAll(tasks);
+        return chains * (depth + 1);
+    }
+
+    public static long ThreadPoolFanOut()
+    {
+        // Blocking briefly forces the pool to grow, so the tracer sees many distinct threads.
+        const int items = 256;
+        long total = 0;
+        Parallel.For(0, items, new ParallelOptions { MaxDegreeOfParallelism = 64 }, i =>
+        {
+            int acc = 0;
+            for (int j = 0; j < 200; j++)
+                acc = Add(acc, Mix(j + i));
+            if ((i & 15) == 0)
+                Thread.Sleep(1);
+            Interlocked.Add(ref total, acc & 1);
+        });
+        return items * 400L;
+    }
+
+    [DllImport("libc", EntryPoint = "getpid")]
+    static extern int GetPidUnix();
+
+    [DllImport("kernel32", EntryPoint = "GetCurrentProcessId")]
+    static extern uint GetPidWindows();
+
+    [DllImport("libc", EntryPoint = "qsort")]
+    static extern unsafe void QsortUnix(void* items, nuint count, nuint size, delegate* unmanaged<void*, void*, int> compare);
+
+    [DllImport("msvcrt", EntryPoint = "qsort")]
+    static extern unsafe void QsortWindows(void* items, nuint count, nuint size, delegate* unmanaged<void*, void*, int> compare);
+
+    // Reverse P/Invoke: every call is an unmanaged-to-managed transition.
+    [UnmanagedCallersOnly]
+    static unsafe int CompareInts(void* a, void* b) => (*(int*)a).CompareTo(*(int*)b);
+
+    public static unsafe long PInvoke()
+    {
+        const int calls = 5_000;
+        for (int i = 0; i < calls; i++)
+        {
+            if (OperatingSystem.IsWindows())
+                GetPidWindows();
+            else
+                GetPidUnix();
+        }
+
+        const int count = 256;
+        int* items = stackalloc int[count];
+        for (int i = 0; i < count; i++)
+            items[i] = (i * 7919) % count;
+        if (OperatingSystem.IsWindows())
+            QsortWindows(items, count, sizeof(int), &CompareInts);
+        else
+            QsortUnix(items, count, sizeof(int), &CompareInts);
+
+        // qsort makes roughly n log2 n comparisons.
+        return calls + count * 8;
+    }
+
+    sealed class WorkloadException : Exception
+    {
+        public WorkloadException(int depth) : base("depth " + depth) { }
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static int ThrowAt(int depth)
+    {
+        if (depth == 0)
+            throw new WorkloadException(depth);
+        return ThrowAt(depth - 1) + 1;
+    }
+
+    public static long Exceptions()
+    {
+        const int throws = 200;
+        const int depth = 10;
+        int caught = 0;
+        for (int i = 0; i < throws; i++)
+        {
+            try
+            {
+                ThrowAt(depth);
+            }
+            catch (WorkloadException)
+            {
+                caught++;
+            }
+        }
+        return (long)caught * (depth + 1);
+    }
+
+    // Plugin hot-reload: load a fresh copy of this assembly into a collectible context, run the
+    // generics workload from it and unload it. Every iteration JITs a new set of FunctionIDs and
+    // unloads a module, so memory that keeps growing across iterations is a leak in the tracer.
+    public static long CollectibleReload()
+    {
+        var context = LoadRunUnload(out long ops);
+        for (int i = 0; context.IsAlive && i < 10; i++)
+        {
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+        }
+        return ops;
+    }
+
+    [MethodImpl(MethodImplOptions.NoInlining)]
+    static WeakReference LoadRunUnload(out long ops)
+    {
+        var context = new AssemblyLoadContext("sw2tracer-reload", isCollectible: true);
+        var assembly = context.LoadFromAssemblyPath(typeof(Workloads).Assembly.Location);
+        var generics = assembly.GetType(typeof(Workloads).FullName!)!.GetMethod(nameof(Generics), BindingFlags.Public | BindingFlags.Static)!;
+        ops = (long)generics.Invoke(null, [null])!;
+        context.Unload();
+        return new WeakReference(context);
+    }
+}
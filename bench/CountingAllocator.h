@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Every allocation (and free) made on a thread is counted on that thread, so a worker can report exactly
+// what its own hook calls allocated without contending on a shared counter. Replaces the global
+// allocation functions, so include it from exactly one translation unit per binary.
+namespace
+{
+  thread_local uint64_t t_allocations = 0;
+  thread_local uint64_t t_allocatedBytes = 0;
+  thread_local uint64_t t_frees = 0;
+
+  void *CountedAlloc(std::size_t size, std::size_t alignment)
+  {
+    t_allocations++;
+    t_allocatedBytes += size;
+    if (size == 0)
+      size = 1;
+    void *p = nullptr;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      p = std::malloc(size);
+#if defined(_WIN32)
+    else
+      p = _aligned_malloc(size, alignment);
+#else
+    else
+      p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    if (p == nullptr)
+      throw std::bad_alloc();
+    return p;
+  }
+
+  void CountedFree(void *p, std::size_t alignment) noexcept
+  {
+    if (p != nullptr)
+      t_frees++;
+#if defined(_WIN32)
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+      _aligned_free(p);
+      return;
+    }
+#endif
+    (void)alignment;
+    std::free(p);
+  }
+}
+
+void *operator new(std::size_t size) { return CountedAlloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new[](std::size_t size) { return CountedAlloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return CountedAlloc(size, static_cast<std::size_t>(alignment)); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return CountedAlloc(size, static_cast<std::size_t>(alignment)); }
+void operator delete(void *p) noexcept { CountedFree(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void *p) noexcept { CountedFree(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void *p, std::size_t) noexcept { CountedFree(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete[](void *p, std::size_t) noexcept { CountedFree(p, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void operator delete(void *p, std::align_val_t alignment) noexcept { CountedFree(p, static_cast<std::size_t>(alignment)); }
+void operator delete[](void *p, std::align_val_t alignment) noexcept { CountedFree(p, static_cast<std::size_t>(alignment)); }
+void operator delete(void *p, std::size_t, std::align_val_t alignment) noexcept { CountedFree(p, static_cast<std::size_t>(alignment)); }
+void operator delete[](void *p, std::size_t, std::align_val_t alignment) noexcept { CountedFree(p, static_cast<std::size_t>(alignment)); }
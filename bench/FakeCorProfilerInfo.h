@@ -0,0 +1,387 @@
+#pragma once
+
+#ifndef _WIN32
+#include "specstrings_undef.h"
+#endif
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "FakeMetaDataImport.h"
+#include "cor.h"
+#include "corprof.h"
+
+// In-process ICorProfilerInfo15 backed by a synthetic set of modules, classes and functions,
+// so StackManager can be driven without a runtime. IDs are derived from table indices, which
+// keeps every run deterministic. The world is built up front and must not change while hook
+// threads are running; only the calls StackManager makes are implemented.
+class FakeCorProfilerInfo : public ICorProfilerInfo15
+{
+public:
+  ModuleID AddModule(const std::string &path, const std::string &assemblyName)
+  {
+    auto module = std::make_unique<Module>();
+    module->path = WidenAscii(path);
+    module->assemblyName = WidenAscii(assemblyName);
+    m_modules.push_back(std::move(module));
+    return ToId(kModuleIdBase, m_modules.size() - 1);
+  }
+
+  FakeMetaDataImport &Metadata(ModuleID moduleId)
+  {
+    return m_modules[FromId(kModuleIdBase, moduleId)]->metadata;
+  }
+
+  ClassID AddClass(ModuleID moduleId, mdTypeDef typeDef, std::vector<ClassID> typeArgs = {})
+  {
+    m_classes.push_back(Class{moduleId, typeDef, std::move(typeArgs)});
+    return ToId(kClassIdBase, m_classes.size() - 1);
+  }
+
+  // typeArgs is the method instantiation reported by GetFunctionInfo2.
+  FunctionID AddFunction(ClassID classId, mdMethodDef methodDef, std::vector<ClassID> typeArgs = {})
+  {
+    m_functions.push_back(Function{classId, methodDef, std::move(typeArgs)});
+    return ToId(kFunctionIdBase, m_functions.size() - 1);
+  }
+
+  size_t FunctionCount() const { return m_functions.size(); }
+  FunctionID FunctionAt(size_t index) const { return ToId(kFunctionIdBase, index); }
+
+  // What GetCurrentThreadID reports on the calling thread; 0 means "not a managed thread".
+  static void SetCurrentThread(ThreadID threadId) { t_currentThread = threadId; }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override
+  {
+    if (ppvObject == nullptr)
+      return E_POINTER;
+    *ppvObject = static_cast<ICorProfilerInfo15 *>(this);
+    return S_OK;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef(void) override { return 1; }
+  ULONG STDMETHODCALLTYPE Release(void) override { return 1; }
+
+  HRESULT STDMETHODCALLTYPE GetCurrentThreadID(ThreadID *pThreadId) override
+  {
+    if (pThreadId == nullptr)
+      return E_INVALIDARG;
+    *pThreadId = t_currentThread;
+    return t_currentThread != 0 ? S_OK : E_FAIL;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetThreadInfo(ThreadID threadId, DWORD *pdwWin32ThreadId) override
+  {
+    if (pdwWin32ThreadId != nullptr)
+      *pdwWin32ThreadId = static_cast<DWORD>(threadId >> 4);
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetFunctionInfo(FunctionID functionId, ClassID *pClassId, ModuleID *pModuleId, mdToken *pToken) override
+  {
+    return GetFunctionInfo2(functionId, 0, pClassId, pModuleId, pToken, 0, nullptr, nullptr);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetFunctionInfo2(FunctionID funcId, COR_PRF_FRAME_INFO frameInfo, ClassID *pClassId, ModuleID *pModuleId, mdToken *pToken, ULONG32 cTypeArgs, ULONG32 *pcTypeArgs, ClassID typeArgs[]) override
+  {
+    const Function *function = Lookup(m_functions, kFunctionIdBase, funcId);
+    if (function == nullptr)
+      return E_INVALIDARG;
+    const Class *cls = Lookup(m_classes, kClassIdBase, function->classId);
+    if (pClassId != nullptr)
+      *pClassId = function->classId;
+    if (pModuleId != nullptr)
+      *pModuleId = cls != nullptr ? cls->moduleId : 0;
+    if (pToken != nullptr)
+      *pToken = function->methodDef;
+    if (pcTypeArgs != nullptr)
+      *pcTypeArgs = static_cast<ULONG32>(function->typeArgs.size());
+    for (ULONG32 i = 0; typeArgs != nullptr && i < cTypeArgs && i < function->typeArgs.size(); i++)
+      typeArgs[i] = function->typeArgs[i];
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetClassIDInfo(ClassID classId, ModuleID *pModuleId, mdTypeDef *pTypeDefToken) override
+  {
+    return GetClassIDInfo2(classId, pModuleId, pTypeDefToken, nullptr, 0, nullptr, nullptr);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetClassIDInfo2(ClassID classId, ModuleID *pModuleId, mdTypeDef *pTypeDefToken, ClassID *pParentClassId, ULONG32 cNumTypeArgs, ULONG32 *pcNumTypeArgs, ClassID typeArgs[]) override
+  {
+    const Class *cls = Lookup(m_classes, kClassIdBase, classId);
+    if (cls == nullptr)
+      return E_INVALIDARG;
+    if (pModuleId != nullptr)
+      *pModuleId = cls->moduleId;
+    if (pTypeDefToken != nullptr)
+      *pTypeDefToken = cls->typeDef;
+    if (pParentClassId != nullptr)
+      *pParentClassId = 0;
+    if (pcNumTypeArgs != nullptr)
+      *pcNumTypeArgs = static_cast<ULONG32>(cls->typeArgs.size());
+    for (ULONG32 i = 0; typeArgs != nullptr && i < cNumTypeArgs && i < cls->typeArgs.size(); i++)
+      typeArgs[i] = cls->typeArgs[i];
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetModuleInfo(ModuleID moduleId, LPCBYTE *ppBaseLoadAddress, ULONG cchName, ULONG *pcchName, WCHAR szName[], AssemblyID *pAssemblyId) override
+  {
+    const Module *module = LookupModule(moduleId);
+    if (module == nullptr)
+      return E_INVALIDARG;
+    if (ppBaseLoadAddress != nullptr)
+      *ppBaseLoadAddress = nullptr;
+    if (pAssemblyId != nullptr)
+      *pAssemblyId = ToId(kAssemblyIdBase, FromId(kModuleIdBase, moduleId));
+    return CopyFakeName(module->path, szName, cchName, pcchName);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetModuleInfo2(ModuleID moduleId, LPCBYTE *ppBaseLoadAddress, ULONG cchName, ULONG *pcchName, WCHAR szName[], AssemblyID *pAssemblyId, DWORD *pdwModuleFlags) override
+  {
+    if (pdwModuleFlags != nullptr)
+      *pdwModuleFlags = COR_PRF_MODULE_DISK;
+    return GetModuleInfo(moduleId, ppBaseLoadAddress, cchName, pcchName, szName, pAssemblyId);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetAssemblyInfo(AssemblyID assemblyId, ULONG cchName, ULONG *pcchName, WCHAR szName[], AppDomainID *pAppDomainId, ModuleID *pModuleId) override
+  {
+    ModuleID moduleId = ToId(kModuleIdBase, FromId(kAssemblyIdBase, assemblyId));
+    const Module *module = LookupModule(moduleId);
+    if (module == nullptr)
+      return E_INVALIDARG;
+    if (pAppDomainId != nullptr)
+      *pAppDomainId = 1;
+    if (pModuleId != nullptr)
+      *pModuleId = moduleId;
+    return CopyFakeName(module->assemblyName, szName, cchName, pcchName);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetModuleMetaData(ModuleID moduleId, DWORD dwOpenFlags, REFIID riid, IUnknown **ppOut) override
+  {
+    Module *module = LookupModule(moduleId);
+    if (module == nullptr || ppOut == nullptr)
+      return E_INVALIDARG;
+    module->metadata.AddRef();
+    *ppOut = static_cast<IMetaDataImport2 *>(&module->metadata);
+    return S_OK;
+  }
+
+  // Reports no argument ranges, so StacksArgs mode only adds the extra GetFunctionEnter3Info call.
+  HRESULT STDMETHODCALLTYPE GetFunctionEnter3Info(FunctionID functionId, COR_PRF_ELT_INFO eltInfo, COR_PRF_FRAME_INFO *pFrameInfo, ULONG *pcbArgumentInfo, COR_PRF_FUNCTION_ARGUMENT_INFO *pArgumentInfo) override
+  {
+    if (pFrameInfo != nullptr)
+      *pFrameInfo = 0;
+    if (pcbArgumentInfo != nullptr)
+      *pcbArgumentInfo = 0;
+    return S_OK;
+  }
+
+  // Every method returns zero bits: 0, false or null depending on the return type.
+  HRESULT STDMETHODCALLTYPE GetFunctionLeave3Info(FunctionID functionId, COR_PRF_ELT_INFO eltInfo, COR_PRF_FRAME_INFO *pFrameInfo, COR_PRF_FUNCTION_ARGUMENT_RANGE *pRetvalRange) override
+  {
+    static const uint64_t zero[2] = {};
+    if (pFrameInfo != nullptr)
+      *pFrameInfo = 0;
+    if (pRetvalRange != nullptr)
+    {
+      pRetvalRange->startAddress = reinterpret_cast<UINT_PTR>(zero);
+      pRetvalRange->length = sizeof(zero);
+    }
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetFunctionTailcall3Info(FunctionID functionId, COR_PRF_ELT_INFO eltInfo, COR_PRF_FRAME_INFO *pFrameInfo) override
+  {
+    if (pFrameInfo != nullptr)
+      *pFrameInfo = 0;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetEventMask(DWORD *pdwEvents) override
+  {
+    if (pdwEvents != nullptr)
+      *pdwEvents = m_eventsLow;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE SetEventMask(DWORD dwEvents) override
+  {
+    m_eventsLow = dwEvents;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetEventMask2(DWORD *pdwEventsLow, DWORD *pdwEventsHigh) override
+  {
+    if (pdwEventsLow != nullptr)
+      *pdwEventsLow = m_eventsLow;
+    if (pdwEventsHigh != nullptr)
+      *pdwEventsHigh = m_eventsHigh;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE SetEventMask2(DWORD dwEventsLow, DWORD dwEventsHigh) override
+  {
+    m_eventsLow = dwEventsLow;
+    m_eventsHigh = dwEventsHigh;
+    return S_OK;
+  }
+
+  // ICorProfilerInfo
+  HRESULT STDMETHODCALLTYPE GetClassFromObject(ObjectID, ClassID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetClassFromToken(ModuleID, mdTypeDef, ClassID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo(FunctionID, LPCBYTE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromIP(LPCBYTE, FunctionID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromToken(ModuleID, mdToken, FunctionID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetHandleFromThread(ThreadID, HANDLE *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetObjectSize(ObjectID, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE IsArrayClass(ClassID, CorElementType *, ClassID *, ULONG *) override { return S_FALSE; }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks(FunctionEnter *, FunctionLeave *, FunctionTailcall *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetFunctionIDMapper(FunctionIDMapper *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetTokenAndMetaDataFromFunction(FunctionID, REFIID, IUnknown **, mdToken *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetILFunctionBody(ModuleID, mdMethodDef, LPCBYTE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetILFunctionBodyAllocator(ModuleID, IMethodMalloc **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetILFunctionBody(ModuleID, mdMethodDef, LPCBYTE) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetAppDomainInfo(AppDomainID, ULONG, ULONG *, WCHAR[], ProcessID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetFunctionReJIT(FunctionID) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE ForceGC(void) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetILInstrumentedCodeMap(FunctionID, BOOL, ULONG, COR_IL_MAP[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetInprocInspectionInterface(IUnknown **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetInprocInspectionIThisThread(IUnknown **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetThreadContext(ThreadID, ContextID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE BeginInprocDebugging(BOOL, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EndInprocDebugging(DWORD) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetILToNativeMapping(FunctionID, ULONG32, ULONG32 *, COR_DEBUG_IL_TO_NATIVE_MAP[]) override { return E_NOTIMPL; }
+
+  // ICorProfilerInfo2
+  HRESULT STDMETHODCALLTYPE DoStackSnapshot(ThreadID, StackSnapshotCallback *, ULONG32, void *, BYTE[], ULONG32) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks2(FunctionEnter2 *, FunctionLeave2 *, FunctionTailcall2 *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetStringLayout(ULONG *, ULONG *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetClassLayout(ClassID, COR_FIELD_OFFSET[], ULONG, ULONG *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo2(FunctionID, ULONG32, ULONG32 *, COR_PRF_CODE_INFO[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetClassFromTokenAndTypeArgs(ModuleID, mdTypeDef, ULONG32, ClassID[], ClassID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromTokenAndTypeArgs(ModuleID, mdMethodDef, ClassID, ULONG32, ClassID[], FunctionID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumModuleFrozenObjects(ModuleID, ICorProfilerObjectEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetArrayObjectInfo(ObjectID, ULONG32, ULONG32[], int[], BYTE **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetBoxClassLayout(ClassID, ULONG32 *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetThreadAppDomain(ThreadID, AppDomainID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetRVAStaticAddress(ClassID, mdFieldDef, void **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetAppDomainStaticAddress(ClassID, mdFieldDef, AppDomainID, void **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetThreadStaticAddress(ClassID, mdFieldDef, ThreadID, void **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetContextStaticAddress(ClassID, mdFieldDef, ContextID, void **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetStaticFieldInfo(ClassID, mdFieldDef, COR_PRF_STATIC_TYPE *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetGenerationBounds(ULONG, ULONG *, COR_PRF_GC_GENERATION_RANGE[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetObjectGeneration(ObjectID, COR_PRF_GC_GENERATION_RANGE *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetNotifiedExceptionClauseInfo(COR_PRF_EX_CLAUSE_INFO *) override { return E_NOTIMPL; }
+
+  // ICorProfilerInfo3
+  HRESULT STDMETHODCALLTYPE EnumJITedFunctions(ICorProfilerFunctionEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE RequestProfilerDetach(DWORD) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetFunctionIDMapper2(FunctionIDMapper2 *, void *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetStringLayout2(ULONG *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks3(FunctionEnter3 *, FunctionLeave3 *, FunctionTailcall3 *) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE SetEnterLeaveFunctionHooks3WithInfo(FunctionEnter3WithInfo *, FunctionLeave3WithInfo *, FunctionTailcall3WithInfo *) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE EnumModules(ICorProfilerModuleEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetRuntimeInformation(USHORT *, COR_PRF_RUNTIME_TYPE *, USHORT *, USHORT *, USHORT *, USHORT *, ULONG, ULONG *, WCHAR[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetThreadStaticAddress2(ClassID, mdFieldDef, AppDomainID, ThreadID, void **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetAppDomainsContainingModule(ModuleID, ULONG32, ULONG32 *, AppDomainID[]) override { return E_NOTIMPL; }
+
+  // ICorProfilerInfo4
+  HRESULT STDMETHODCALLTYPE EnumThreads(ICorProfilerThreadEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE InitializeCurrentThread(void) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE RequestReJIT(ULONG, ModuleID[], mdMethodDef[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE RequestRevert(ULONG, ModuleID[], mdMethodDef[], HRESULT[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo3(FunctionID, ReJITID, ULONG32, ULONG32 *, COR_PRF_CODE_INFO[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromIP2(LPCBYTE, FunctionID *, ReJITID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetReJITIDs(FunctionID, ULONG, ULONG *, ReJITID[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetILToNativeMapping2(FunctionID, ReJITID, ULONG32, ULONG32 *, COR_DEBUG_IL_TO_NATIVE_MAP[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumJITedFunctions2(ICorProfilerFunctionEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetObjectSize2(ObjectID, SIZE_T *) override { return E_NOTIMPL; }
+
+  // ICorProfilerInfo6 .. 15
+  HRESULT STDMETHODCALLTYPE EnumNgenModuleMethodsInliningThisMethod(ModuleID, ModuleID, mdMethodDef, BOOL *, ICorProfilerMethodEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE ApplyMetaData(ModuleID) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetInMemorySymbolsLength(ModuleID, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE ReadInMemorySymbols(ModuleID, DWORD, BYTE *, DWORD, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE IsFunctionDynamic(FunctionID, BOOL *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFunctionFromIP3(LPCBYTE, FunctionID *, ReJITID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetDynamicFunctionInfo(FunctionID, ModuleID *, PCCOR_SIGNATURE *, ULONG *, ULONG, ULONG *, WCHAR[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetNativeCodeStartAddresses(FunctionID, ReJITID, ULONG32, ULONG32 *, UINT_PTR[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetILToNativeMapping3(UINT_PTR, ULONG32, ULONG32 *, COR_DEBUG_IL_TO_NATIVE_MAP[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCodeInfo4(UINT_PTR, ULONG32, ULONG32 *, COR_PRF_CODE_INFO[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumerateObjectReferences(ObjectID, ObjectReferenceCallback, void *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE IsFrozenObject(ObjectID, BOOL *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetLOHObjectSizeThreshold(DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE RequestReJITWithInliners(DWORD, ULONG, ModuleID[], mdMethodDef[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SuspendRuntime(void) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE ResumeRuntime(void) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetEnvironmentVariable(const WCHAR *, ULONG, ULONG *, WCHAR[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE SetEnvironmentVariable(const WCHAR *, const WCHAR *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeStartSession(UINT32, COR_PRF_EVENTPIPE_PROVIDER_CONFIG[], BOOL, EVENTPIPE_SESSION *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeAddProviderToSession(EVENTPIPE_SESSION, COR_PRF_EVENTPIPE_PROVIDER_CONFIG) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeStopSession(EVENTPIPE_SESSION) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeCreateProvider(const WCHAR *, EVENTPIPE_PROVIDER *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeGetProviderInfo(EVENTPIPE_PROVIDER, ULONG, ULONG *, WCHAR[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeDefineEvent(EVENTPIPE_PROVIDER, const WCHAR *, UINT32, UINT64, UINT32, UINT32, UINT8, BOOL, UINT32, COR_PRF_EVENTPIPE_PARAM_DESC[], EVENTPIPE_EVENT *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeWriteEvent(EVENTPIPE_EVENT, UINT32, COR_PRF_EVENT_DATA[], LPCGUID, LPCGUID) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE CreateHandle(ObjectID, COR_PRF_HANDLE_TYPE, ObjectHandleID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE DestroyHandle(ObjectHandleID) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetObjectIDFromHandle(ObjectHandleID, ObjectID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumerateNonGCObjects(ICorProfilerObjectEnum **) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetNonGCHeapBounds(ULONG, ULONG *, COR_PRF_NONGC_HEAP_RANGE[]) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EventPipeCreateProvider2(const WCHAR *, EventPipeProviderCallback *, EVENTPIPE_PROVIDER *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumerateGCHeapObjects(ObjectCallback, void *) override { return E_NOTIMPL; }
+
+private:
+  // Non-zero, 16-byte aligned and disjoint per kind, like the runtime's pointer-valued IDs.
+  static constexpr UINT_PTR kModuleIdBase = 0x10000000;
+  static constexpr UINT_PTR kAssemblyIdBase = 0x20000000;
+  static constexpr UINT_PTR kClassIdBase = 0x30000000;
+  static constexpr UINT_PTR kFunctionIdBase = 0x40000000;
+
+  static UINT_PTR ToId(UINT_PTR base, size_t index) { return base + (static_cast<UINT_PTR>(index) << 4); }
+  static size_t FromId(UINT_PTR base, UINT_PTR id) { return static_cast<size_t>((id - base) >> 4); }
+
+  struct Module
+  {
+    std::basic_string<WCHAR> path;
+    std::basic_string<WCHAR> assemblyName;
+    FakeMetaDataImport metadata;
+  };
+
+  struct Class
+  {
+    ModuleID moduleId = 0;
+    mdTypeDef typeDef = mdTypeDefNil;
+    std::vector<ClassID> typeArgs;
+  };
+
+  struct Function
+  {
+    ClassID classId = 0;
+    mdMethodDef methodDef = mdMethodDefNil;
+    std::vector<ClassID> typeArgs;
+  };
+
+  template <typename T>
+  static const T *Lookup(const std::vector<T> &table, UINT_PTR base, UINT_PTR id)
+  {
+    if (id < base || ((id - base) & 0xF) != 0 || FromId(base, id) >= table.size())
+      return nullptr;
+    return &table[FromId(base, id)];
+  }
+
+  Module *LookupModule(ModuleID moduleId)
+  {
+    if (moduleId < kModuleIdBase || ((moduleId - kModuleIdBase) & 0xF) != 0 || FromId(kModuleIdBase, moduleId) >= m_modules.size())
+      return nullptr;
+    return m_modules[FromId(kModuleIdBase, moduleId)].get();
+  }
+
+  static inline thread_local ThreadID t_currentThread = 0;
+
+  std::vector<std::unique_ptr<Module>> m_modules;
+  std::vector<Class> m_classes;
+  std::vector<Function> m_functions;
+  DWORD m_eventsLow = 0;
+  DWORD m_eventsHigh = 0;
+};
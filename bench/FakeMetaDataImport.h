@@ -0,0 +1,349 @@
+#pragma once
+
+#ifndef _WIN32
+#include "specstrings_undef.h"
+#endif
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "Helper.h"
+#include "cor.h"
+#include "corprof.h"
+
+inline std::basic_string<WCHAR> WidenAscii(const std::string &in)
+{
+  std::basic_string<WCHAR> out;
+  out.reserve(in.size());
+  for (char c : in)
+    out += static_cast<WCHAR>(static_cast<unsigned char>(c));
+  return out;
+}
+
+// Mirrors the runtime's cch/pcch convention: pcch always receives the length including the
+// terminator, the buffer is filled (truncated) only when one is supplied.
+inline HRESULT CopyFakeName(const std::basic_string<WCHAR> &name, WCHAR *buffer, ULONG cch, ULONG *pcch)
+{
+  if (pcch != nullptr)
+    *pcch = static_cast<ULONG>(name.size() + 1);
+  if (buffer != nullptr && cch > 0)
+    CopyWTrunc(buffer, cch, name);
+  return S_OK;
+}
+
+// In-memory IMetaDataImport2 for one synthetic module. Only the calls the tracer makes while
+// symbolizing (type/method/param props, type refs and specs, param enumeration) are backed by
+// data; everything else returns E_NOTIMPL. Tokens are handed out in insertion order.
+class FakeMetaDataImport : public IMetaDataImport2
+{
+public:
+  mdTypeDef AddTypeDef(const std::string &name, DWORD flags = tdPublic, mdTypeDef enclosing = mdTypeDefNil)
+  {
+    m_typeDefs.push_back(TypeDef{WidenAscii(name), flags, enclosing});
+    return TokenFromRid(static_cast<RID>(m_typeDefs.size()), mdtTypeDef);
+  }
+
+  mdTypeRef AddTypeRef(const std::string &name)
+  {
+    m_typeRefs.push_back(WidenAscii(name));
+    return TokenFromRid(static_cast<RID>(m_typeRefs.size()), mdtTypeRef);
+  }
+
+  mdTypeSpec AddTypeSpec(std::vector<COR_SIGNATURE> signature)
+  {
+    m_typeSpecs.push_back(std::move(signature));
+    return TokenFromRid(static_cast<RID>(m_typeSpecs.size()), mdtTypeSpec);
+  }
+
+  mdMethodDef AddMethodDef(mdTypeDef owner, const std::string &name, std::vector<COR_SIGNATURE> signature, const std::vector<std::string> &paramNames = {})
+  {
+    MethodDef method{owner, WidenAscii(name), std::move(signature), {}};
+    mdMethodDef token = TokenFromRid(static_cast<RID>(m_methodDefs.size() + 1), mdtMethodDef);
+    for (size_t i = 0; i < paramNames.size(); i++)
+    {
+      m_paramDefs.push_back(ParamDef{token, static_cast<ULONG>(i + 1), WidenAscii(paramNames[i])});
+      method.params.push_back(TokenFromRid(static_cast<RID>(m_paramDefs.size()), mdtParamDef));
+    }
+    m_methodDefs.push_back(std::move(method));
+    return token;
+  }
+
+  // Swap a blob in place so the fuzz harness can reuse one world for every input. The blob is
+  // stored at its exact size, which lets a sanitizer catch any read past its end.
+  void SetMethodSignature(mdMethodDef token, std::vector<COR_SIGNATURE> signature)
+  {
+    m_methodDefs[RidFromToken(token) - 1].signature = std::move(signature);
+  }
+
+  void SetTypeSpec(mdTypeSpec token, std::vector<COR_SIGNATURE> signature)
+  {
+    m_typeSpecs[RidFromToken(token) - 1] = std::move(signature);
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override
+  {
+    if (ppvObject == nullptr)
+      return E_POINTER;
+    *ppvObject = static_cast<IMetaDataImport2 *>(this);
+    AddRef();
+    return S_OK;
+  }
+
+  // Owned by the fake profiler info; the count only exists so leaks show up in the bench.
+  ULONG STDMETHODCALLTYPE AddRef(void) override { return ++m_refCount; }
+  ULONG STDMETHODCALLTYPE Release(void) override { return --m_refCount; }
+  ULONG RefCount() const { return m_refCount.load(); }
+
+  void STDMETHODCALLTYPE CloseEnum(HCORENUM hEnum) override
+  {
+    delete static_cast<TokenEnum *>(hEnum);
+  }
+
+  HRESULT STDMETHODCALLTYPE CountEnum(HCORENUM hEnum, ULONG *pulCount) override
+  {
+    if (pulCount != nullptr)
+      *pulCount = hEnum != nullptr ? static_cast<ULONG>(static_cast<TokenEnum *>(hEnum)->tokens.size()) : 0;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE ResetEnum(HCORENUM hEnum, ULONG ulPos) override
+  {
+    if (hEnum != nullptr)
+      static_cast<TokenEnum *>(hEnum)->next = ulPos;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetTypeDefProps(mdTypeDef td, LPWSTR szTypeDef, ULONG cchTypeDef, ULONG *pchTypeDef, DWORD *pdwTypeDefFlags, mdToken *ptkExtends) override
+  {
+    const TypeDef *type = Lookup(m_typeDefs, td, mdtTypeDef);
+    if (type == nullptr)
+      return E_INVALIDARG;
+    if (pdwTypeDefFlags != nullptr)
+      *pdwTypeDefFlags = type->flags;
+    if (ptkExtends != nullptr)
+      *ptkExtends = mdTypeRefNil;
+    return CopyFakeName(type->name, szTypeDef, cchTypeDef, pchTypeDef);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetNestedClassProps(mdTypeDef tdNestedClass, mdTypeDef *ptdEnclosingClass) override
+  {
+    const TypeDef *type = Lookup(m_typeDefs, tdNestedClass, mdtTypeDef);
+    if (type == nullptr || type->enclosing == mdTypeDefNil)
+      return E_INVALIDARG;
+    if (ptdEnclosingClass != nullptr)
+      *ptdEnclosingClass = type->enclosing;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetTypeRefProps(mdTypeRef tr, mdToken *ptkResolutionScope, LPWSTR szName, ULONG cchName, ULONG *pchName) override
+  {
+    const std::basic_string<WCHAR> *name = Lookup(m_typeRefs, tr, mdtTypeRef);
+    if (name == nullptr)
+      return E_INVALIDARG;
+    if (ptkResolutionScope != nullptr)
+      *ptkResolutionScope = mdTokenNil;
+    return CopyFakeName(*name, szName, cchName, pchName);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetTypeSpecFromToken(mdTypeSpec typespec, PCCOR_SIGNATURE *ppvSig, ULONG *pcbSig) override
+  {
+    const std::vector<COR_SIGNATURE> *signature = Lookup(m_typeSpecs, typespec, mdtTypeSpec);
+    if (signature == nullptr)
+      return E_INVALIDARG;
+    if (ppvSig != nullptr)
+      *ppvSig = signature->data();
+    if (pcbSig != nullptr)
+      *pcbSig = static_cast<ULONG>(signature->size());
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetMethodProps(mdMethodDef mb, mdTypeDef *pClass, LPWSTR szMethod, ULONG cchMethod, ULONG *pchMethod, DWORD *pdwAttr, PCCOR_SIGNATURE *ppvSigBlob, ULONG *pcbSigBlob, ULONG *pulCodeRVA, DWORD *pdwImplFlags) override
+  {
+    const MethodDef *method = Lookup(m_methodDefs, mb, mdtMethodDef);
+    if (method == nullptr)
+      return E_INVALIDARG;
+    if (pClass != nullptr)
+      *pClass = method->owner;
+    if (pdwAttr != nullptr)
+      *pdwAttr = mdPublic;
+    if (ppvSigBlob != nullptr)
+      *ppvSigBlob = method->signature.data();
+    if (pcbSigBlob != nullptr)
+      *pcbSigBlob = static_cast<ULONG>(method->signature.size());
+    if (pulCodeRVA != nullptr)
+      *pulCodeRVA = 0;
+    if (pdwImplFlags != nullptr)
+      *pdwImplFlags = miIL;
+    return CopyFakeName(method->name, szMethod, cchMethod, pchMethod);
+  }
+
+  HRESULT STDMETHODCALLTYPE EnumParams(HCORENUM *phEnum, mdMethodDef mb, mdParamDef rParams[], ULONG cMax, ULONG *pcTokens) override
+  {
+    if (phEnum == nullptr)
+      return E_INVALIDARG;
+    if (*phEnum == nullptr)
+    {
+      const MethodDef *method = Lookup(m_methodDefs, mb, mdtMethodDef);
+      if (method == nullptr)
+        return E_INVALIDARG;
+      *phEnum = new TokenEnum{method->params, 0};
+    }
+    return static_cast<TokenEnum *>(*phEnum)->Next(rParams, cMax, pcTokens);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetParamProps(mdParamDef tk, mdMethodDef *pmd, ULONG *pulSequence, LPWSTR szName, ULONG cchName, ULONG *pchName, DWORD *pdwAttr, DWORD *pdwCPlusTypeFlag, UVCP_CONSTANT *ppValue, ULONG *pcchValue) override
+  {
+    const ParamDef *param = Lookup(m_paramDefs, tk, mdtParamDef);
+    if (param == nullptr)
+      return E_INVALIDARG;
+    if (pmd != nullptr)
+      *pmd = param->method;
+    if (pulSequence != nullptr)
+      *pulSequence = param->sequence;
+    if (pdwAttr != nullptr)
+      *pdwAttr = 0;
+    if (pdwCPlusTypeFlag != nullptr)
+      *pdwCPlusTypeFlag = ELEMENT_TYPE_VOID;
+    if (ppValue != nullptr)
+      *ppValue = nullptr;
+    if (pcchValue != nullptr)
+      *pcchValue = 0;
+    return CopyFakeName(param->name, szName, cchName, pchName);
+  }
+
+  BOOL STDMETHODCALLTYPE IsValidToken(mdToken tk) override
+  {
+    switch (TypeFromToken(tk))
+    {
+    case mdtTypeDef:
+      return Lookup(m_typeDefs, tk, mdtTypeDef) != nullptr;
+    case mdtTypeRef:
+      return Lookup(m_typeRefs, tk, mdtTypeRef) != nullptr;
+    case mdtTypeSpec:
+      return Lookup(m_typeSpecs, tk, mdtTypeSpec) != nullptr;
+    case mdtMethodDef:
+      return Lookup(m_methodDefs, tk, mdtMethodDef) != nullptr;
+    case mdtParamDef:
+      return Lookup(m_paramDefs, tk, mdtParamDef) != nullptr;
+    default:
+      return FALSE;
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE EnumTypeDefs(HCORENUM *, mdTypeDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumInterfaceImpls(HCORENUM *, mdTypeDef, mdInterfaceImpl[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumTypeRefs(HCORENUM *, mdTypeRef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindTypeDefByName(LPCWSTR, mdToken, mdTypeDef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetScopeProps(LPWSTR, ULONG, ULONG *, GUID *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetModuleFromScope(mdModule *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetInterfaceImplProps(mdInterfaceImpl, mdTypeDef *, mdToken *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE ResolveTypeRef(mdTypeRef, REFIID, IUnknown **, mdTypeDef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMembers(HCORENUM *, mdTypeDef, mdToken[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMembersWithName(HCORENUM *, mdTypeDef, LPCWSTR, mdToken[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMethods(HCORENUM *, mdTypeDef, mdMethodDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMethodsWithName(HCORENUM *, mdTypeDef, LPCWSTR, mdMethodDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumFields(HCORENUM *, mdTypeDef, mdFieldDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumFieldsWithName(HCORENUM *, mdTypeDef, LPCWSTR, mdFieldDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMemberRefs(HCORENUM *, mdToken, mdMemberRef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMethodImpls(HCORENUM *, mdTypeDef, mdToken[], mdToken[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumPermissionSets(HCORENUM *, mdToken, DWORD, mdPermission[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindMember(mdTypeDef, LPCWSTR, PCCOR_SIGNATURE, ULONG, mdToken *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindMethod(mdTypeDef, LPCWSTR, PCCOR_SIGNATURE, ULONG, mdMethodDef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindField(mdTypeDef, LPCWSTR, PCCOR_SIGNATURE, ULONG, mdFieldDef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindMemberRef(mdTypeRef, LPCWSTR, PCCOR_SIGNATURE, ULONG, mdMemberRef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetMemberRefProps(mdMemberRef, mdToken *, LPWSTR, ULONG, ULONG *, PCCOR_SIGNATURE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumProperties(HCORENUM *, mdTypeDef, mdProperty[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumEvents(HCORENUM *, mdTypeDef, mdEvent[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetEventProps(mdEvent, mdTypeDef *, LPCWSTR, ULONG, ULONG *, DWORD *, mdToken *, mdMethodDef *, mdMethodDef *, mdMethodDef *, mdMethodDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMethodSemantics(HCORENUM *, mdMethodDef, mdToken[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetMethodSemantics(mdMethodDef, mdToken, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetClassLayout(mdTypeDef, DWORD *, COR_FIELD_OFFSET[], ULONG, ULONG *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFieldMarshal(mdToken, PCCOR_SIGNATURE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetRVA(mdToken, ULONG *, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetPermissionSetProps(mdPermission, DWORD *, void const **, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetSigFromToken(mdSignature, PCCOR_SIGNATURE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetModuleRefProps(mdModuleRef, LPWSTR, ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumModuleRefs(HCORENUM *, mdModuleRef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetNameFromToken(mdToken, MDUTF8CSTR *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumUnresolvedMethods(HCORENUM *, mdToken[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetUserString(mdString, LPWSTR, ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetPinvokeMap(mdToken, DWORD *, LPWSTR, ULONG, ULONG *, mdModuleRef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumSignatures(HCORENUM *, mdSignature[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumTypeSpecs(HCORENUM *, mdTypeSpec[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumUserStrings(HCORENUM *, mdString[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetParamForMethodIndex(mdMethodDef, ULONG, mdParamDef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumCustomAttributes(HCORENUM *, mdToken, mdToken, mdCustomAttribute[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCustomAttributeProps(mdCustomAttribute, mdToken *, mdToken *, void const **, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE FindTypeRef(mdToken, LPCWSTR, mdTypeRef *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetMemberProps(mdToken, mdTypeDef *, LPWSTR, ULONG, ULONG *, DWORD *, PCCOR_SIGNATURE *, ULONG *, ULONG *, DWORD *, DWORD *, UVCP_CONSTANT *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetFieldProps(mdFieldDef, mdTypeDef *, LPWSTR, ULONG, ULONG *, DWORD *, PCCOR_SIGNATURE *, ULONG *, DWORD *, UVCP_CONSTANT *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetPropertyProps(mdProperty, mdTypeDef *, LPCWSTR, ULONG, ULONG *, DWORD *, PCCOR_SIGNATURE *, ULONG *, DWORD *, UVCP_CONSTANT *, ULONG *, mdMethodDef *, mdMethodDef *, mdMethodDef[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetCustomAttributeByName(mdToken, LPCWSTR, const void **, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetNativeCallConvFromSig(void const *, ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE IsGlobal(mdToken, int *) override { return E_NOTIMPL; }
+
+  HRESULT STDMETHODCALLTYPE EnumGenericParams(HCORENUM *, mdToken, mdGenericParam[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetGenericParamProps(mdGenericParam, ULONG *, DWORD *, mdToken *, DWORD *, LPWSTR, ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetMethodSpecProps(mdMethodSpec, mdToken *, PCCOR_SIGNATURE *, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumGenericParamConstraints(HCORENUM *, mdGenericParam, mdGenericParamConstraint[], ULONG, ULONG *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetGenericParamConstraintProps(mdGenericParamConstraint, mdGenericParam *, mdToken *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetPEKind(DWORD *, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE GetVersionString(LPWSTR, DWORD, DWORD *) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE EnumMethodSpecs(HCORENUM *, mdToken, mdMethodSpec[], ULONG, ULONG *) override { return E_NOTIMPL; }
+
+private:
+  struct TypeDef
+  {
+    std::basic_string<WCHAR> name;
+    DWORD flags = tdPublic;
+    mdTypeDef enclosing = mdTypeDefNil;
+  };
+
+  struct MethodDef
+  {
+    mdTypeDef owner = mdTypeDefNil;
+    std::basic_string<WCHAR> name;
+    std::vector<COR_SIGNATURE> signature;
+    std::vector<mdParamDef> params;
+  };
+
+  struct ParamDef
+  {
+    mdMethodDef method = mdMethodDefNil;
+    ULONG sequence = 0;
+    std::basic_string<WCHAR> name;
+  };
+
+  // Heap-allocated like the runtime's HENUMInternal, so symbolization allocation counts stay honest.
+  struct TokenEnum
+  {
+    std::vector<mdToken> tokens;
+    size_t next = 0;
+
+    HRESULT Next(mdToken out[], ULONG cMax, ULONG *pcTokens)
+    {
+      ULONG fetched = 0;
+      while (fetched < cMax && next < tokens.size())
+        out[fetched++] = tokens[next++];
+      if (pcTokens != nullptr)
+        *pcTokens = fetched;
+      return fetched > 0 ? S_OK : S_FALSE;
+    }
+  };
+
+  template <typename T>
+  static const T *Lookup(const std::vector<T> &table, mdToken token, CorTokenType type)
+  {
+    RID rid = RidFromToken(token);
+    if (TypeFromToken(token) != static_cast<mdToken>(type) || rid == 0 || rid > table.size())
+      return nullptr;
+    return &table[rid - 1];
+  }
+
+  std::atomic<ULONG> m_refCount{1};
+  std::vector<TypeDef> m_typeDefs;
+  std::vector<std::basic_string<WCHAR>> m_typeRefs;
+  std::vector<std::vector<COR_SIGNATURE>> m_typeSpecs;
+  std::vector<MethodDef> m_methodDefs;
+  std::vector<ParamDef> m_paramDefs;
+};
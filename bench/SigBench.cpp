@@ -0,0 +1,452 @@
+#ifndef _WIN32
+#include "specstrings_undef.h"
+#endif
+
+#include "Guid.h"
+#include "CountingAllocator.h"
+#include "FakeCorProfilerInfo.h"
+#include "Helper.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Feeds synthetic signature blobs through ParseSigType, GetTypeNameFromTypeToken and
+// GetMethodSignature against a fake metadata scope. Every case has an expected rendering, so a
+// faster or bounds-checked parser can be checked for identical output and timed without a
+// runtime. Built with the fuzz option, LLVMFuzzerTestOneInput replaces main.
+namespace
+{
+  std::vector<COR_SIGNATURE> Sig(std::initializer_list<int> bytes)
+  {
+    std::vector<COR_SIGNATURE> out;
+    for (int b : bytes)
+      out.push_back(static_cast<COR_SIGNATURE>(b));
+    return out;
+  }
+
+  // Compressed TypeDefOrRef tokens for the scope built in BuildWorld.
+  enum : int
+  {
+    kWidget = 0x04,       // TypeDef 1  Sig.Widget
+    kOuter = 0x08,        // TypeDef 2  Sig.Outer`1
+    kInner = 0x0C,        // TypeDef 3  Sig.Widget+Inner
+    kPoint = 0x10,        // TypeDef 4  Sig.Point (value type)
+    kDictionary = 0x05,   // TypeRef 1  System.Collections.Generic.Dictionary`2
+    kList = 0x09,         // TypeRef 2  System.Collections.Generic.List`1
+    kNullable = 0x0D,     // TypeRef 3  System.Nullable`1
+    kListOfString = 0x06, // TypeSpec 1  List<string>
+  };
+
+  // Rendered with no profiler info, so VAR/MVAR stay as !n / !!n.
+  struct TypeCase
+  {
+    const char *name;
+    std::vector<COR_SIGNATURE> blob;
+    const char *expected;
+  };
+
+  enum class TypeArgs
+  {
+    None,
+    PointWidget,
+    Widget,
+  };
+
+  struct MethodCase
+  {
+    const char *name;
+    const char *declaringType;
+    const char *methodName;
+    std::vector<COR_SIGNATURE> signature;
+    std::vector<std::string> paramNames;
+    TypeArgs typeArgs;
+    const char *expected;
+  };
+
+  std::vector<TypeCase> TypeCases()
+  {
+    return {
+        {"primitive", Sig({ELEMENT_TYPE_U8}), "ulong"},
+        {"typeref", Sig({ELEMENT_TYPE_CLASS, kList}), "System.Collections.Generic.List"},
+        {"nested-typedef", Sig({ELEMENT_TYPE_CLASS, kInner}), "Sig.Widget+Inner"},
+        {"nested-generics", Sig({ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kDictionary, 2, ELEMENT_TYPE_STRING, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kList, 1, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_VALUETYPE, kNullable, 1, ELEMENT_TYPE_I4}),
+         "System.Collections.Generic.Dictionary<string, System.Collections.Generic.List<System.Nullable<int>>>"},
+        {"generic-typedef", Sig({ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kOuter, 1, ELEMENT_TYPE_VALUETYPE, kPoint}), "Sig.Outer<Sig.Point>"},
+        {"typespec-arg", Sig({ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_CLASS, kListOfString}), "System.Collections.Generic.List<string>[]"},
+        {"jagged-array", Sig({ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_R8}), "double[][]"},
+        {"md-array-sizes", Sig({ELEMENT_TYPE_ARRAY, ELEMENT_TYPE_I4, 2, 2, 3, 4, 2, 0, 0}), "int[,]"},
+        // Lower bound -1 uses the signed compressed encoding (0x7F).
+        {"md-array-lobound", Sig({ELEMENT_TYPE_ARRAY, ELEMENT_TYPE_STRING, 3, 0, 1, 0x7F}), "string[,,]"},
+        {"byref-array", Sig({ELEMENT_TYPE_BYREF, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_OBJECT}), "object[]&"},
+        {"pointer-pointer", Sig({ELEMENT_TYPE_PTR, ELEMENT_TYPE_PTR, ELEMENT_TYPE_U1}), "byte**"},
+        {"var", Sig({ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kList, 1, ELEMENT_TYPE_VAR, 0}), "System.Collections.Generic.List<!0>"},
+        {"mvar", Sig({ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_MVAR, 1}), "!!1[]"},
+        {"fnptr", Sig({ELEMENT_TYPE_FNPTR, IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_I4, ELEMENT_TYPE_I4, ELEMENT_TYPE_STRING}), "fnptr"},
+        // Blobs that end early render as nothing rather than reading past their end.
+        {"cut-generic-args", Sig({ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kDictionary, 2, ELEMENT_TYPE_STRING}), ""},
+        {"cut-token", Sig({ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_CLASS, 0x80}), ""},
+        {"cut-array-bounds", Sig({ELEMENT_TYPE_ARRAY, ELEMENT_TYPE_I4, 2, 2, 3}), ""},
+        {"cut-fnptr", Sig({ELEMENT_TYPE_FNPTR, IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_I4}), ""},
+    };
+  }
+
+  std::vector<MethodCase> MethodCases()
+  {
+    return {
+        {"primitives", "Sig.Widget", "Primitives",
+         Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 3, ELEMENT_TYPE_VOID, ELEMENT_TYPE_I4, ELEMENT_TYPE_STRING, ELEMENT_TYPE_R8}), {"a", "b", "c"}, TypeArgs::None,
+         "void Sig.Widget.Primitives(int a, string b, double c)"},
+        {"nested-generics", "Sig.Widget", "Group",
+         Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 1, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kDictionary, 2, ELEMENT_TYPE_STRING, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kList, 1, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_VALUETYPE, kNullable, 1, ELEMENT_TYPE_I4, ELEMENT_TYPE_CLASS, kListOfString}),
+         {"source"}, TypeArgs::None,
+         "System.Collections.Generic.Dictionary<string, System.Collections.Generic.List<System.Nullable<int>>> Sig.Widget.Group(System.Collections.Generic.List<string> source)"},
+        {"arrays", "Sig.Widget", "Reshape",
+         Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 3, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_I4, ELEMENT_TYPE_ARRAY, ELEMENT_TYPE_I4, 2, 2, 3, 4, 2, 0, 0, ELEMENT_TYPE_ARRAY, ELEMENT_TYPE_STRING, 3, 0, 1, 0x7F, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_CLASS, kWidget}),
+         {"grid", "cube", "widgets"}, TypeArgs::None,
+         "int[][] Sig.Widget.Reshape(int[,] grid, string[,,] cube, Sig.Widget[] widgets)"},
+        {"byrefs", "Sig.Widget", "Locate",
+         Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 4, ELEMENT_TYPE_BYREF, ELEMENT_TYPE_VALUETYPE, kPoint, ELEMENT_TYPE_BYREF, ELEMENT_TYPE_I4, ELEMENT_TYPE_PTR, ELEMENT_TYPE_PTR, ELEMENT_TYPE_U1, ELEMENT_TYPE_TYPEDBYREF, ELEMENT_TYPE_BYREF, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_OBJECT}),
+         {"index", "buffer", "any"}, TypeArgs::None,
+         "Sig.Point& Sig.Widget.Locate(int& index, byte** buffer, typedref any, object[]&)"},
+        // A parameter after the function pointer only renders if the nested signature is consumed.
+        {"fnptr", "Sig.Widget", "Invoke",
+         Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_VOID, ELEMENT_TYPE_FNPTR, IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_I4, ELEMENT_TYPE_I4, ELEMENT_TYPE_STRING, ELEMENT_TYPE_I8}),
+         {"callback", "state"}, TypeArgs::None,
+         "void Sig.Widget.Invoke(fnptr callback, long state)"},
+        {"mvar-resolved", "Sig.Widget", "Convert",
+         Sig({IMAGE_CEE_CS_CALLCONV_GENERIC, 2, 2, ELEMENT_TYPE_MVAR, 0, ELEMENT_TYPE_MVAR, 1, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_MVAR, 0}),
+         {"value", "items"}, TypeArgs::PointWidget,
+         "Sig.Point Sig.Widget.Convert(Sig.Widget value, Sig.Point[] items)"},
+        {"mvar-unresolved", "Sig.Widget", "Convert",
+         Sig({IMAGE_CEE_CS_CALLCONV_GENERIC, 2, 2, ELEMENT_TYPE_MVAR, 0, ELEMENT_TYPE_MVAR, 1, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_MVAR, 0}),
+         {"value", "items"}, TypeArgs::None,
+         "!!0 Sig.Widget.Convert(!!1 value, !!0[] items)"},
+        {"var", "Sig.Outer<Sig.Widget>", "Add",
+         Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 2, ELEMENT_TYPE_VOID, ELEMENT_TYPE_VAR, 0, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kList, 1, ELEMENT_TYPE_VAR, 0}),
+         {"item", "batch"}, TypeArgs::Widget,
+         "void Sig.Outer<Sig.Widget>.Add(Sig.Widget item, System.Collections.Generic.List<Sig.Widget> batch)"},
+        {"nested-type", "Sig.Widget", "Make",
+         Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 1, ELEMENT_TYPE_CLASS, kInner, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kOuter, 1, ELEMENT_TYPE_VALUETYPE, kPoint}),
+         {"origin"}, TypeArgs::None,
+         "Sig.Widget+Inner Sig.Widget.Make(Sig.Outer<Sig.Point> origin)"},
+        // The second parameter is cut off, with type arguments or without.
+        {"cut-parameter", "Sig.Widget", "Cut",
+         Sig({IMAGE_CEE_CS_CALLCONV_GENERIC, 1, 2, ELEMENT_TYPE_VOID, ELEMENT_TYPE_MVAR, 0, ELEMENT_TYPE_SZARRAY}),
+         {"first", "second"}, TypeArgs::Widget, ""},
+    };
+  }
+
+  struct World
+  {
+    FakeCorProfilerInfo info;
+    ModuleID moduleId = 0;
+    std::vector<mdTypeSpec> typeSpecs; // one per TypeCase
+    std::vector<FunctionID> functions; // one per MethodCase
+    mdTypeSpec fuzzTypeSpec = mdTypeSpecNil;
+    FunctionID fuzzFunction = 0;
+    mdMethodDef fuzzMethod = mdMethodDefNil;
+  };
+
+  void BuildWorld(World &world, const std::vector<TypeCase> &typeCases, const std::vector<MethodCase> &methodCases)
+  {
+    world.moduleId = world.info.AddModule("/bench/Sig.Tests.dll", "Sig.Tests");
+    auto &metadata = world.info.Metadata(world.moduleId);
+
+    mdTypeDef widget = metadata.AddTypeDef("Sig.Widget");
+    mdTypeDef outer = metadata.AddTypeDef("Sig.Outer`1");
+    metadata.AddTypeDef("Inner", tdNestedPublic, widget);
+    mdTypeDef point = metadata.AddTypeDef("Sig.Point");
+    metadata.AddTypeRef("System.Collections.Generic.Dictionary`2");
+    metadata.AddTypeRef("System.Collections.Generic.List`1");
+    metadata.AddTypeRef("System.Nullable`1");
+    metadata.AddTypeSpec(Sig({ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, kList, 1, ELEMENT_TYPE_STRING}));
+
+    ClassID widgetClass = world.info.AddClass(world.moduleId, widget);
+    ClassID pointClass = world.info.AddClass(world.moduleId, point);
+    ClassID outerOfWidget = world.info.AddClass(world.moduleId, outer, {widgetClass});
+
+    for (const auto &c : typeCases)
+      world.typeSpecs.push_back(metadata.AddTypeSpec(c.blob));
+
+    for (const auto &c : methodCases)
+    {
+      bool onWidget = std::strcmp(c.declaringType, "Sig.Widget") == 0;
+      std::vector<ClassID> typeArgs;
+      if (c.typeArgs == TypeArgs::PointWidget)
+        typeArgs = {pointClass, widgetClass};
+      else if (c.typeArgs == TypeArgs::Widget)
+        typeArgs = {widgetClass};
+      mdMethodDef method = metadata.AddMethodDef(onWidget ? widget : outer, c.methodName, c.signature, c.paramNames);
+      world.functions.push_back(world.info.AddFunction(onWidget ? widgetClass : outerOfWidget, method, std::move(typeArgs)));
+    }
+
+    world.fuzzTypeSpec = metadata.AddTypeSpec(Sig({ELEMENT_TYPE_VOID}));
+    world.fuzzMethod = metadata.AddMethodDef(widget, "Fuzz", Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}), {"a", "b", "c", "d"});
+    world.fuzzFunction = world.info.AddFunction(widgetClass, world.fuzzMethod, {pointClass, widgetClass});
+  }
+
+  IMetaDataImport2 *Metadata(World &world)
+  {
+    return &world.info.Metadata(world.moduleId);
+  }
+
+  std::string RenderParsed(World &world, const std::vector<COR_SIGNATURE> &blob)
+  {
+    PCCOR_SIGNATURE p = blob.data();
+    return ParseSigType(nullptr, Metadata(world), world.moduleId, nullptr, 0, p, blob.data() + blob.size());
+  }
+
+  bool Check(const char *entryPoint, const char *name, const std::string &actual, const char *expected)
+  {
+    bool ok = actual == expected;
+    std::printf("%-4s %-26s %-18s %s\n", ok ? "ok" : "FAIL", entryPoint, name, actual.c_str());
+    if (!ok)
+      std::printf("     %-26s %-18s expected %s\n", "", "", expected);
+    return ok;
+  }
+
+  size_t Validate(World &world, const std::vector<TypeCase> &typeCases, const std::vector<MethodCase> &methodCases)
+  {
+    size_t failures = 0;
+    for (size_t i = 0; i < typeCases.size(); i++)
+    {
+      const auto &c = typeCases[i];
+      failures += !Check("ParseSigType", c.name, RenderParsed(world, c.blob), c.expected);
+      failures += !Check("GetTypeNameFromTypeToken", c.name, GetTypeNameFromTypeToken(Metadata(world), world.typeSpecs[i]), c.expected);
+    }
+    for (size_t i = 0; i < methodCases.size(); i++)
+    {
+      const auto &c = methodCases[i];
+      failures += !Check("GetMethodSignature", c.name, GetMethodSignature(&world.info, world.functions[i], 0, c.declaringType), c.expected);
+    }
+    return failures;
+  }
+
+  template <typename Fn>
+  void Measure(const char *entryPoint, size_t rounds, size_t callsPerRound, Fn &&round)
+  {
+    uint64_t allocations = t_allocations;
+    uint64_t allocatedBytes = t_allocatedBytes;
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+      sink += round();
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    double calls = static_cast<double>(rounds * callsPerRound);
+
+    std::printf("%-26s %12.0f %10.1f %10.3f %12.1f %12.1f\n", entryPoint, calls, ns / calls, calls * 1e3 / ns,
+                (double)(t_allocations - allocations) / calls, (double)(t_allocatedBytes - allocatedBytes) / calls);
+    if (sink == 0)
+      std::printf("(no output)\n");
+  }
+
+  void Benchmark(World &world, const std::vector<TypeCase> &typeCases, const std::vector<MethodCase> &methodCases, size_t rounds)
+  {
+    std::printf("\n%-26s %12s %10s %10s %12s %12s\n", "entry point", "calls", "ns/call", "Mcalls/s", "allocs/call", "bytes/call");
+    Measure("ParseSigType", rounds, typeCases.size(), [&]() {
+      size_t n = 0;
+      for (const auto &c : typeCases)
+        n += RenderParsed(world, c.blob).size();
+      return n;
+    });
+    Measure("GetTypeNameFromTypeToken", rounds, typeCases.size(), [&]() {
+      size_t n = 0;
+      for (mdTypeSpec token : world.typeSpecs)
+        n += GetTypeNameFromTypeToken(Metadata(world), token).size();
+      return n;
+    });
+    Measure("GetMethodSignature", rounds, methodCases.size(), [&]() {
+      size_t n = 0;
+      for (size_t i = 0; i < methodCases.size(); i++)
+        n += GetMethodSignature(&world.info, world.functions[i], 0, methodCases[i].declaringType).size();
+      return n;
+    });
+  }
+
+  World &FuzzWorld()
+  {
+    static World *world = []() {
+      auto *w = new World();
+      BuildWorld(*w, {}, {});
+      return w;
+    }();
+    return *world;
+  }
+
+  // The first byte picks the entry point; the rest is the blob, stored at its exact size.
+  void RunFuzzInput(const uint8_t *data, size_t size)
+  {
+    if (size < 2)
+      return;
+    World &world = FuzzWorld();
+    std::vector<COR_SIGNATURE> blob(data + 1, data + size);
+    switch (data[0] % 3)
+    {
+    case 0:
+      RenderParsed(world, blob);
+      break;
+    case 1:
+      world.info.Metadata(world.moduleId).SetTypeSpec(world.fuzzTypeSpec, std::move(blob));
+      GetTypeNameFromTypeToken(Metadata(world), world.fuzzTypeSpec);
+      break;
+    default:
+      world.info.Metadata(world.moduleId).SetMethodSignature(world.fuzzMethod, std::move(blob));
+      GetMethodSignature(&world.info, world.fuzzFunction, 0, "Sig.Widget");
+      break;
+    }
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  RunFuzzInput(data, size);
+  return 0;
+}
+
+#ifndef SW2TRACER_FUZZ
+namespace
+{
+  struct Rng
+  {
+    uint64_t state;
+
+    uint64_t Next()
+    {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return state * 0x2545F4914F6CDD1Dull;
+    }
+  };
+
+  // A dumb mutator over the known-good blobs for builds without libFuzzer: flips, inserts,
+  // deletes and truncates bytes. Good enough to trip a sanitizer on an unchecked read.
+  void MutationFuzz(const std::vector<TypeCase> &typeCases, const std::vector<MethodCase> &methodCases, size_t inputs, uint64_t seed)
+  {
+    std::vector<std::vector<uint8_t>> corpus;
+    for (const auto &c : typeCases)
+    {
+      corpus.push_back({0});
+      corpus.back().insert(corpus.back().end(), c.blob.begin(), c.blob.end());
+      corpus.push_back({1});
+      corpus.back().insert(corpus.back().end(), c.blob.begin(), c.blob.end());
+    }
+    for (const auto &c : methodCases)
+    {
+      corpus.push_back({2});
+      corpus.back().insert(corpus.back().end(), c.signature.begin(), c.signature.end());
+    }
+
+    Rng rng{seed | 1};
+    for (size_t i = 0; i < inputs; i++)
+    {
+      std::vector<uint8_t> input = corpus[rng.Next() % corpus.size()];
+      size_t edits = 1 + rng.Next() % 4;
+      for (size_t e = 0; e < edits && input.size() > 1; e++)
+      {
+        size_t at = 1 + rng.Next() % (input.size() - 1);
+        switch (rng.Next() % 4)
+        {
+        case 0:
+          input[at] ^= static_cast<uint8_t>(1u << (rng.Next() % 8));
+          break;
+        case 1:
+          input.insert(input.begin() + static_cast<std::ptrdiff_t>(at), static_cast<uint8_t>(rng.Next()));
+          break;
+        case 2:
+          input.erase(input.begin() + static_cast<std::ptrdiff_t>(at));
+          break;
+        default:
+          input.resize(at);
+          break;
+        }
+      }
+      RunFuzzInput(input.data(), input.size());
+    }
+    std::printf("\nfuzz: %zu mutated inputs, no crash\n", inputs);
+  }
+
+  struct SigBenchOptions
+  {
+    size_t rounds = 20000;
+    size_t fuzzInputs = 0;
+    uint64_t seed = 0x5157324E;
+    std::vector<std::string> replay;
+  };
+
+  void PrintUsage()
+  {
+    std::printf("usage: sw2tracer_sigbench [--rounds N] [--fuzz N] [--seed N] [--replay FILE]...\n"
+                "--fuzz mutates the built-in cases; --replay runs saved fuzzer inputs.\n");
+  }
+
+  bool ParseOptions(int argc, char **argv, SigBenchOptions &options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+      auto number = [&]() { i++; return static_cast<size_t>(std::strtoull(value, nullptr, 10)); };
+
+      if (value == nullptr)
+        return false;
+      else if (arg == "--rounds")
+        options.rounds = number();
+      else if (arg == "--fuzz")
+        options.fuzzInputs = number();
+      else if (arg == "--seed")
+        options.seed = number();
+      else if (arg == "--replay")
+      {
+        i++;
+        options.replay.push_back(value);
+      }
+      else
+        return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  SigBenchOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  for (const auto &path : options.replay)
+  {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::printf("replay %s (%zu bytes)\n", path.c_str(), input.size());
+    RunFuzzInput(input.data(), input.size());
+  }
+  if (!options.replay.empty())
+    return 0;
+
+  const auto typeCases = TypeCases();
+  const auto methodCases = MethodCases();
+  static World world;
+  BuildWorld(world, typeCases, methodCases);
+
+  size_t failures = Validate(world, typeCases, methodCases);
+  if (options.rounds > 0)
+    Benchmark(world, typeCases, methodCases, options.rounds);
+  if (options.fuzzInputs > 0)
+    MutationFuzz(typeCases, methodCases, options.fuzzInputs, options.seed);
+
+  if (failures > 0)
+    std::printf("\n%zu signature check(s) failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,615 @@
+#ifndef _WIN32
+#include "specstrings_undef.h"
+#endif
+
+#include "Guid.h"
+#include "CountingAllocator.h"
+#include "FakeCorProfilerInfo.h"
+#include "StackManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  struct BenchOptions
+  {
+    size_t maxThreads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 16);
+    size_t opsPerThread = 4000000;
+    size_t modules = 8;
+    size_t functions = 4096;
+    size_t meanDepth = 24;
+    // Closed instantiations per generic type; each gets its own ClassID and FunctionIDs.
+    size_t instantiations = 1;
+    uint64_t seed = 0x5157324E;
+    TracerMode mode = TracerMode::Stacks;
+    TracerConfig config = TracerConfig::FromEnvironment();
+  };
+
+  struct Rng
+  {
+    uint64_t state;
+
+    uint64_t Next()
+    {
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    // True with probability perMille / 1000.
+    bool Chance(uint32_t perMille) { return Next() % 1000 < perMille; }
+  };
+
+  enum class OpKind : uint8_t
+  {
+    Enter,
+    Leave,
+    Tailcall,
+    Transition,
+  };
+
+  struct Op
+  {
+    FunctionID functionId;
+    UINT_PTR stackPointer;
+    OpKind kind;
+  };
+
+  std::vector<COR_SIGNATURE> Sig(std::initializer_list<int> bytes)
+  {
+    std::vector<COR_SIGNATURE> out;
+    for (int b : bytes)
+      out.push_back(static_cast<COR_SIGNATURE>(b));
+    return out;
+  }
+
+  struct MethodShape
+  {
+    std::vector<COR_SIGNATURE> signature;
+    std::vector<std::string> paramNames;
+  };
+
+  // Compressed tokens below assume TypeDef rid 1 (0x04) and TypeRef rid 1 (0x05) exist in every module.
+  std::vector<MethodShape> MethodShapes()
+  {
+    return {
+        {Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}), {}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 2, ELEMENT_TYPE_I4, ELEMENT_TYPE_I4, ELEMENT_TYPE_STRING}), {"count", "name"}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_DEFAULT, 2, ELEMENT_TYPE_STRING, ELEMENT_TYPE_OBJECT, ELEMENT_TYPE_SZARRAY, ELEMENT_TYPE_I4}), {"value", "items"}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 1, ELEMENT_TYPE_BOOLEAN, ELEMENT_TYPE_CLASS, 0x04}), {"other"}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_GENERIC, 1, 1, ELEMENT_TYPE_MVAR, 0, ELEMENT_TYPE_MVAR, 0}), {"item"}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 3, ELEMENT_TYPE_VOID, ELEMENT_TYPE_I8, ELEMENT_TYPE_R8, ELEMENT_TYPE_GENERICINST, ELEMENT_TYPE_CLASS, 0x05, 1, ELEMENT_TYPE_I4}), {"id", "weight", "list"}},
+        {Sig({IMAGE_CEE_CS_CALLCONV_HASTHIS, 1, ELEMENT_TYPE_VOID, ELEMENT_TYPE_BYREF, ELEMENT_TYPE_VALUETYPE, 0x04}), {"state"}},
+    };
+  }
+
+  // Spreads `functions` methods over `modules` modules with ~8 methods per type. Every fourth
+  // type is generic over the first type of module 0 and every eighth is nested in its predecessor,
+  // so symbolization walks the same paths it does for real assemblies.
+  void BuildWorld(FakeCorProfilerInfo &info, size_t modules, size_t functions, size_t instantiations)
+  {
+    const auto shapes = MethodShapes();
+    const size_t perModule = (functions + modules - 1) / modules;
+    std::vector<ClassID> closedTypes;
+    size_t created = 0;
+
+    for (size_t m = 0; m < modules && created < functions; m++)
+    {
+      std::string assemblyName = "Bench.Assembly" + std::to_string(m);
+      ModuleID moduleId = info.AddModule("/bench/" + assemblyName + ".dll", assemblyName);
+      auto &metadata = info.Metadata(moduleId);
+      metadata.AddTypeRef("System.Collections.Generic.List`1");
+
+      mdTypeDef previous = mdTypeDefNil;
+      for (size_t t = 0; created < functions && t * 8 < perModule; t++)
+      {
+        bool generic = t % 4 == 3;
+        bool nested = t % 8 == 7 && previous != mdTypeDefNil;
+        std::string typeName = nested ? "Inner" + std::to_string(t) : "Bench.M" + std::to_string(m) + ".Type" + std::to_string(t);
+        if (generic)
+          typeName += "`1";
+
+        mdTypeDef typeDef = metadata.AddTypeDef(typeName, nested ? tdNestedPublic : tdPublic, nested ? previous : mdTypeDefNil);
+        std::vector<ClassID> classIds;
+        if (generic && !closedTypes.empty())
+        {
+          for (size_t n = 0; n < instantiations; n++)
+            classIds.push_back(info.AddClass(moduleId, typeDef, {closedTypes[n % closedTypes.size()]}));
+        }
+        else
+        {
+          classIds.push_back(info.AddClass(moduleId, typeDef));
+          if (!generic)
+            closedTypes.push_back(classIds.back());
+        }
+
+        for (size_t k = 0; k < 8 && created < functions; k++, created++)
+        {
+          const auto &shape = shapes[created % shapes.size()];
+          mdMethodDef methodDef = metadata.AddMethodDef(typeDef, "Method" + std::to_string(k), shape.signature, shape.paramNames);
+          for (ClassID classId : classIds)
+            info.AddFunction(classId, methodDef);
+        }
+        previous = typeDef;
+      }
+    }
+  }
+
+  // A balanced random walk of hook calls: depth hovers around meanDepth, roughly 90% of calls
+  // go to a hot set of 64 functions, 5% are direct recursion, with occasional deep recursive
+  // bursts, 2% of returns are tailcalls and 1% of calls arrive through a reverse P/Invoke.
+  std::vector<Op> BuildScript(const FakeCorProfilerInfo &info, const BenchOptions &options, uint64_t seed, UINT_PTR stackBase, size_t length)
+  {
+    struct Frame
+    {
+      FunctionID functionId;
+      UINT_PTR stackPointer;
+    };
+
+    Rng rng{seed | 1};
+    const size_t hot = std::min<size_t>(64, info.FunctionCount());
+    std::vector<Op> script;
+    std::vector<Frame> frames;
+    script.reserve(length + 512);
+
+    auto pick = [&]() -> FunctionID {
+      if (!frames.empty() && rng.Chance(50))
+        return frames.back().functionId;
+      if (rng.Chance(900))
+        return info.FunctionAt(rng.Next() % hot);
+      return info.FunctionAt(rng.Next() % info.FunctionCount());
+    };
+
+    auto push = [&](FunctionID functionId) {
+      UINT_PTR sp = frames.empty() ? stackBase : frames.back().stackPointer - 16 * (2 + rng.Next() % 30);
+      frames.push_back(Frame{functionId, sp});
+      script.push_back(Op{functionId, sp, OpKind::Enter});
+    };
+
+    while (script.size() < length)
+    {
+      if (rng.Chance(1) && frames.size() < 1024)
+      {
+        FunctionID recursive = pick();
+        size_t burst = 50 + rng.Next() % 150;
+        for (size_t i = 0; i < burst; i++)
+          push(recursive);
+        continue;
+      }
+
+      bool enter = frames.empty() || (frames.size() < options.meanDepth ? rng.Chance(600) : rng.Chance(400));
+      if (enter)
+      {
+        FunctionID functionId = pick();
+        if (rng.Chance(10))
+          script.push_back(Op{functionId, 0, OpKind::Transition});
+        push(functionId);
+      }
+      else if (rng.Chance(20))
+      {
+        // The tail-calling frame is replaced by its callee at the same stack pointer.
+        Frame top = frames.back();
+        frames.pop_back();
+        script.push_back(Op{top.functionId, top.stackPointer, OpKind::Tailcall});
+        FunctionID callee = pick();
+        frames.push_back(Frame{callee, top.stackPointer});
+        script.push_back(Op{callee, top.stackPointer, OpKind::Enter});
+      }
+      else
+      {
+        script.push_back(Op{frames.back().functionId, frames.back().stackPointer, OpKind::Leave});
+        frames.pop_back();
+      }
+    }
+
+    while (!frames.empty())
+    {
+      script.push_back(Op{frames.back().functionId, frames.back().stackPointer, OpKind::Leave});
+      frames.pop_back();
+    }
+    return script;
+  }
+
+  // Same gate the ELT stubs in CorProfiler.cpp apply before reaching StackManager. Transitions,
+  // and an eltInfo worth querying, are only passed when the config would have asked for them.
+  void Replay(StackManager *manager, const std::vector<Op> &script, const TracerConfig &config)
+  {
+    const COR_PRF_ELT_INFO eltInfo = config.WantsEltInfo() ? 1 : 0;
+    for (const Op &op : script)
+    {
+      if (!IsTracingEnabled())
+        continue;
+
+      FunctionIDOrClientID id;
+      id.functionID = op.functionId;
+      switch (op.kind)
+      {
+      case OpKind::Enter:
+        manager->FunctionEnter(id, eltInfo, op.stackPointer);
+        break;
+      case OpKind::Leave:
+        manager->FunctionLeave(id, eltInfo, op.stackPointer);
+        break;
+      case OpKind::Tailcall:
+        manager->FunctionTailcall(id, eltInfo, op.stackPointer);
+        break;
+      case OpKind::Transition:
+        if (config.transitions)
+          manager->OnUnmanagedToManaged(op.functionId, COR_PRF_TRANSITION_CALL);
+        break;
+      }
+    }
+  }
+
+  struct RunResult
+  {
+    size_t threads = 0;
+    uint64_t ops = 0;
+    double wallSeconds = 0;
+    double threadNs = 0;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+  };
+
+  RunResult RunThreads(const BenchOptions &options, const std::vector<std::vector<Op>> &scripts, size_t threadCount, ThreadID threadIdBase)
+  {
+    StackManager *manager = GlobalStackManager();
+    std::vector<RunResult> perThread(threadCount);
+    std::vector<std::thread> workers;
+    std::latch ready(static_cast<std::ptrdiff_t>(threadCount + 1));
+    std::latch go(1);
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+      workers.emplace_back([&, i]() {
+        ThreadID tid = threadIdBase + (static_cast<ThreadID>(i) << 4);
+        FakeCorProfilerInfo::SetCurrentThread(tid);
+        manager->OnThreadCreated(tid);
+        manager->OnThreadAssignedToOSThread(tid, static_cast<DWORD>(tid >> 4));
+
+        const auto &script = scripts[i];
+        Replay(manager, script, options.config);
+
+        ready.count_down();
+        go.wait();
+
+        uint64_t allocations = t_allocations;
+        uint64_t allocatedBytes = t_allocatedBytes;
+        uint64_t ops = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (ops < options.opsPerThread)
+        {
+          Replay(manager, script, options.config);
+          ops += script.size();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        auto &result = perThread[i];
+        result.ops = ops;
+        result.threadNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        result.allocations = t_allocations - allocations;
+        result.allocatedBytes = t_allocatedBytes - allocatedBytes;
+
+        manager->OnThreadDestroyed(tid);
+        FakeCorProfilerInfo::SetCurrentThread(0);
+      });
+    }
+
+    ready.arrive_and_wait();
+    auto start = std::chrono::steady_clock::now();
+    go.count_down();
+    for (auto &worker : workers)
+      worker.join();
+    auto wall = std::chrono::steady_clock::now() - start;
+
+    RunResult total;
+    total.threads = threadCount;
+    total.wallSeconds = std::chrono::duration<double>(wall).count();
+    for (const auto &r : perThread)
+    {
+      total.ops += r.ops;
+      total.threadNs += r.threadNs;
+      total.allocations += r.allocations;
+      total.allocatedBytes += r.allocatedBytes;
+    }
+    return total;
+  }
+
+  // Walks every function once on a fresh thread so each FunctionInfo is built exactly once.
+  void MeasureSymbolization(const FakeCorProfilerInfo &info)
+  {
+    StackManager *manager = GlobalStackManager();
+    const ThreadID tid = 0x7F000000;
+    FakeCorProfilerInfo::SetCurrentThread(tid);
+
+    uint64_t allocations = t_allocations;
+    uint64_t allocatedBytes = t_allocatedBytes;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < info.FunctionCount(); i++)
+    {
+      FunctionIDOrClientID id;
+      id.functionID = info.FunctionAt(i);
+      manager->FunctionEnter(id, 0, 0x10000);
+      manager->FunctionLeave(id, 0, 0x10000);
+    }
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    uint64_t count = std::max<uint64_t>(info.FunctionCount(), 1);
+
+    SW2TracerStats stats{};
+    stats.size = sizeof(stats);
+    manager->GetStats(stats);
+    std::printf("symbolization: %zu functions, %.0f ns/function, %.1f allocations/function, %.0f bytes/function, method tokens hit/parsed %llu/%llu\n",
+                info.FunctionCount(), ns / count, (double)(t_allocations - allocations) / count, (double)(t_allocatedBytes - allocatedBytes) / count,
+                (unsigned long long)stats.methodTokenCacheHits, (unsigned long long)stats.methodTokenCacheMisses);
+
+    manager->OnThreadDestroyed(tid);
+    FakeCorProfilerInfo::SetCurrentThread(0);
+  }
+
+  // SW2TracerGetStack on a thread holding a stack of the mean depth: what an error handler pays to
+  // attach the managed stack to its report.
+  void MeasureStackQuery(FakeCorProfilerInfo &info, const BenchOptions &options)
+  {
+    StackManager *manager = GlobalStackManager();
+    const ThreadID tid = 0x7E000000;
+    FakeCorProfilerInfo::SetCurrentThread(tid);
+
+    const size_t depth = std::max<size_t>(options.meanDepth, 1);
+    for (size_t i = 0; i < depth; i++)
+    {
+      FunctionIDOrClientID id;
+      id.functionID = info.FunctionAt(i % info.FunctionCount());
+      manager->FunctionEnter(id, 0, 0x100000 - 64 * i);
+    }
+
+    static SW2TracerFrame frames[256];
+    const size_t queries = 100000;
+    size_t written = 0;
+    uint64_t allocations = t_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries; i++)
+      written += manager->GetStack(0, frames, 256, nullptr);
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    std::printf("stack query: depth %zu, %.0f ns/query, %.1f allocations/query, top %s\n", written / queries, ns / queries,
+                (double)(t_allocations - allocations) / queries, frames[0].methodSignature);
+
+    manager->OnThreadDestroyed(tid);
+    FakeCorProfilerInfo::SetCurrentThread(0);
+  }
+
+  // SW2TracerGetStack on threads with nothing to report must return no frames and release no
+  // memory, also while an evicted FunctionInfo is still waiting to be freed.
+  bool CheckStackQuery(FakeCorProfilerInfo &info)
+  {
+    StackManager *manager = GlobalStackManager();
+    static SW2TracerFrame frames[4];
+    bool ok = true;
+    auto expectEmpty = [&](const char *what, ThreadID tid) {
+      size_t depth = 1;
+      uint64_t allocations = t_allocations;
+      uint64_t frees = t_frees;
+      size_t written = manager->GetStack(tid, frames, 4, &depth);
+      bool passed = written == 0 && depth == 0 && t_allocations == allocations && t_frees == frees;
+      std::printf("%-4s stack query: %s\n", passed ? "ok" : "FAIL", what);
+      ok = ok && passed;
+    };
+
+    expectEmpty("unknown thread", 0x7D000000);
+
+    const ThreadID tid = 0x7D000001;
+    FakeCorProfilerInfo::SetCurrentThread(tid);
+    ModuleID moduleId = info.AddModule("/bench/Bench.Unloaded.dll", "Bench.Unloaded");
+    auto &metadata = info.Metadata(moduleId);
+    mdTypeDef typeDef = metadata.AddTypeDef("Bench.Unloaded.Type", tdPublic, mdTypeDefNil);
+    mdMethodDef methodDef = metadata.AddMethodDef(typeDef, "Method", {IMAGE_CEE_CS_CALLCONV_DEFAULT, 0, ELEMENT_TYPE_VOID}, {});
+    FunctionIDOrClientID id;
+    id.functionID = info.AddFunction(info.AddClass(moduleId, typeDef), methodDef);
+    manager->FunctionEnter(id, 0, 0x1000);
+    manager->FunctionLeave(id, 0, 0x1000);
+    expectEmpty("empty stack", tid);
+
+    // A reader that does not reclaim is open across the eviction, so the FunctionInfo stays
+    // retired after it closes; the old GetStack freed it on the way out.
+    {
+      StackManager::SymbolReadScope reader(*manager, false);
+      manager->OnModuleUnloadStarted(moduleId);
+    }
+    expectEmpty("empty stack, evicted symbols pending", tid);
+    manager->OnModuleUnloadFinished(moduleId);
+
+    manager->OnThreadDestroyed(tid);
+    expectEmpty("destroyed thread", tid);
+    FakeCorProfilerInfo::SetCurrentThread(0);
+    return ok;
+  }
+
+  // Upper bound in ns of the bucket holding the given fraction of sampled hook calls.
+  double HistogramPercentileNs(const uint64_t (&histogram)[kHookHistogramBuckets], double fraction)
+  {
+    uint64_t total = 0;
+    for (uint64_t count : histogram)
+      total += count;
+    if (total == 0)
+      return 0;
+
+    uint64_t target = static_cast<uint64_t>(fraction * (double)total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kHookHistogramBuckets; i++)
+    {
+      seen += histogram[i];
+      if (seen > target)
+        return (double)(1ull << i) / TscTicksPerNanosecond();
+    }
+    return (double)(1ull << (kHookHistogramBuckets - 1)) / TscTicksPerNanosecond();
+  }
+
+  bool ParseMode(const char *value, TracerMode &mode)
+  {
+    static const std::pair<const char *, TracerMode> kModes[] = {
+        {"off", TracerMode::Off},
+        {"stacks", TracerMode::Stacks},
+        {"args", TracerMode::StacksArgs},
+        {"timing", TracerMode::Timing},
+    };
+    for (const auto &[name, candidate] : kModes)
+    {
+      if (std::strcmp(name, value) == 0)
+      {
+        mode = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void PrintUsage()
+  {
+    std::printf("usage: sw2tracer_bench [--threads N] [--ops N] [--functions N] [--modules N] [--depth N]\n"
+                "                       [--instantiations N] [--slow-us N] [--assembly-time]\n"
+                "                       [--mode off|stacks|args|timing] [--lean] [--retval] [--cct] [--flight N] [--seed N]\n"
+                "--lean drops frame info and transitions (no frame-info query); --mode args enables argument capture;\n"
+                "--retval records every method's return value (SW2TRACER_RETVAL_FILTER narrows it);\n"
+                "--slow-us logs calls slower than N microseconds (SW2TRACER_SLOW_CALL_FILTER narrows it);\n"
+                "--assembly-time charges exclusive time to each frame's assembly.\n"
+                "SW2TRACER_* environment variables are honoured; flags override them.\n");
+  }
+
+  bool ParseOptions(int argc, char **argv, BenchOptions &options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+      auto number = [&]() { i++; return static_cast<size_t>(std::strtoull(value, nullptr, 10)); };
+
+      if (arg == "--cct")
+        options.config.callingContextTree = true;
+      else if (arg == "--lean")
+      {
+        options.config.frameInfo = false;
+        options.config.transitions = false;
+      }
+      else if (arg == "--retval")
+        options.config.captureReturns = true;
+      else if (arg == "--assembly-time")
+        options.config.assemblyTime = true;
+      else if (value == nullptr)
+        return false;
+      else if (arg == "--threads")
+        options.maxThreads = std::max<size_t>(number(), 1);
+      else if (arg == "--ops")
+        options.opsPerThread = std::max<size_t>(number(), 1);
+      else if (arg == "--functions")
+        options.functions = std::max<size_t>(number(), 1);
+      else if (arg == "--modules")
+        options.modules = std::max<size_t>(number(), 1);
+      else if (arg == "--depth")
+        options.meanDepth = std::max<size_t>(number(), 1);
+      else if (arg == "--instantiations")
+        options.instantiations = std::max<size_t>(number(), 1);
+      else if (arg == "--slow-us")
+        options.config.slowCallThresholdUs = static_cast<uint32_t>(number());
+      else if (arg == "--flight")
+        options.config.flightRecorderEvents = static_cast<uint32_t>(number());
+      else if (arg == "--seed")
+        options.seed = number();
+      else if (arg == "--mode")
+      {
+        i++;
+        if (!ParseMode(value, options.mode))
+          return false;
+      }
+      else
+        return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  static FakeCorProfilerInfo info;
+  BuildWorld(info, options.modules, options.functions, options.instantiations);
+
+  if (options.mode == TracerMode::StacksArgs)
+    options.config.captureArgs = true;
+
+  StackManager *manager = GlobalStackManager();
+  manager->SetConfig(options.config);
+  manager->SetCorProfilerInfo(&info);
+  manager->SetMode(options.mode);
+
+  std::printf("sw2tracer_bench: mode=%u eltInfo=%d threads<=%zu ops/thread=%zu functions=%zu modules=%zu depth~%zu cct=%d flight=%u tsc=%.3f ticks/ns\n",
+              static_cast<unsigned>(options.mode), options.config.WantsEltInfo() ? 1 : 0, options.maxThreads, options.opsPerThread, info.FunctionCount(), options.modules,
+              options.meanDepth, options.config.callingContextTree ? 1 : 0, options.config.flightRecorderEvents, TscTicksPerNanosecond());
+
+  MeasureSymbolization(info);
+  MeasureStackQuery(info, options);
+
+  std::vector<std::vector<Op>> scripts;
+  for (size_t i = 0; i < options.maxThreads; i++)
+    scripts.push_back(BuildScript(info, options, options.seed + i * 0x9E3779B9ull, 0x7FFF00000000ull - (static_cast<UINT_PTR>(i) << 24), 1 << 16));
+
+  std::vector<size_t> threadCounts;
+  for (size_t t = 1; t < options.maxThreads; t *= 2)
+    threadCounts.push_back(t);
+  threadCounts.push_back(options.maxThreads);
+
+  std::printf("\n%8s %12s %10s %10s %12s %12s\n", "threads", "Mops/s", "ns/op", "scaling", "allocs/op", "bytes/op");
+  double singleThreadRate = 0;
+  ThreadID threadIdBase = 0x01000000;
+  for (size_t threads : threadCounts)
+  {
+    RunResult r = RunThreads(options, scripts, threads, threadIdBase);
+    threadIdBase += 0x00100000;
+
+    double rate = (double)r.ops / r.wallSeconds;
+    if (singleThreadRate == 0)
+      singleThreadRate = rate;
+    std::printf("%8zu %12.2f %10.2f %9.0f%% %12.4f %12.2f\n", threads, rate / 1e6, r.threadNs / (double)r.ops,
+                100.0 * rate / (singleThreadRate * (double)threads), (double)r.allocations / (double)r.ops, (double)r.allocatedBytes / (double)r.ops);
+  }
+
+  SW2TracerStats stats{};
+  stats.size = sizeof(stats);
+  manager->GetStats(stats);
+  std::printf("\nhooks: enters=%llu leaves=%llu tailcalls=%llu desync(not found/not top)=%llu/%llu max depth=%llu folded=%llu capped=%llu\n",
+              (unsigned long long)stats.enters, (unsigned long long)stats.leaves, (unsigned long long)stats.tailcalls,
+              (unsigned long long)stats.desyncNotFound, (unsigned long long)stats.desyncFoundNotTop, (unsigned long long)stats.maxStackDepth,
+              (unsigned long long)stats.foldedEnters, (unsigned long long)stats.depthCapDrops);
+  if (options.config.WantsSlowCalls())
+    std::printf("slow calls logged: %llu\n", (unsigned long long)stats.slowCalls);
+  if (options.config.assemblyTime)
+  {
+    SW2TracerAssemblyTime assemblies[4];
+    size_t count = manager->GetAssemblyTime(assemblies, 4);
+    std::printf("busiest assemblies:");
+    for (size_t i = 0; i < count; i++)
+      std::printf(" %s=%llu ms/%llu calls", assemblies[i].assemblyName, (unsigned long long)(assemblies[i].exclusiveNs / 1000000), (unsigned long long)assemblies[i].calls);
+    std::printf("\n");
+  }
+  std::printf("sampled hook latency (1 in %llu): enter p50<=%.0f ns p99<=%.0f ns, leave p50<=%.0f ns p99<=%.0f ns\n",
+              (unsigned long long)stats.hookSampleInterval,
+              HistogramPercentileNs(stats.enterCyclesHistogram, 0.50), HistogramPercentileNs(stats.enterCyclesHistogram, 0.99),
+              HistogramPercentileNs(stats.leaveCyclesHistogram, 0.50), HistogramPercentileNs(stats.leaveCyclesHistogram, 0.99));
+
+  std::printf("\n");
+  return CheckStackQuery(info) ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+# Runs each DotnetTest workload with and without the profiler and reports throughput overhead,
+# p99 iteration latency, JIT time and working-set growth. The profiled run also checks the shadow stack against
+# Environment.StackTrace and, for alc-reload, bounds working-set growth per reload. SW2TRACER_* variables are passed through to the profiled run.
+#
+#   .\overhead.ps1 [-Iterations N] [-Profiles lean,default,args,alloc] [scenario ...]
+#
+# Profiles select which ELT capabilities the profiler asks the runtime for:
+#   lean     no frame info, no transitions (no ELT flags in the event mask)
+#   default  frame info and transitions
+#   args     default plus COR_PRF_ENABLE_FUNCTION_ARGS
+#   alloc    default plus allocation sampling (AllocationTick over an in-process EventPipe session)
+param(
+    [int]$Iterations = 200,
+    [string[]]$Profiles = @("default"),
+    [Parameter(ValueFromRemainingArguments = $true)][string[]]$Scenarios
+)
+
+$profilerPath = if ($env:CORECLR_PROFILER_PATH) { $env:CORECLR_PROFILER_PATH } else { "./build/windows/x64/release/sw2tracer.dll" }
+
+$profileEnv = @{
+    lean    = @{ SW2TRACER_FRAME_INFO = "0"; SW2TRACER_TRANSITIONS = "0" }
+    default = @{}
+    args    = @{ SW2TRACER_ARGS = "1" }
+    alloc   = @{ SW2TRACER_ALLOC = "1" }
+}
+
+dotnet build -c Release ./DotnetTest/DotnetTest.csproj -nologo -v q | Out-Null
+$app = "./DotnetTest/bin/Release/net10.0/DotnetTest.exe"
+if (-not $Scenarios) { $Scenarios = & $app --list }
+
+function Get-Field([string]$line, [string]$name) {
+    if ($line -match " $name=(\S+)") { return [double]$Matches[1] }
+    return 0
+}
+
+$failed = 0
+"{0,-14} {1,-8} {2,14} {3,14} {4,10} {5,12} {6,12} {7,10} {8,10} {9,10}" -f "scenario", "profile", "base ops/s", "traced ops/s", "overhead", "base p99us", "traced p99us", "base jit", "traced jit", "traced mem"
+foreach ($s in $Scenarios) {
+    Remove-Item Env:CORECLR_ENABLE_PROFILING -ErrorAction SilentlyContinue
+    $base = & $app $s --iterations $Iterations | Where-Object { $_ -like "RESULT*" }
+
+    foreach ($p in $Profiles) {
+        if (-not $profileEnv.ContainsKey($p)) { Write-Error "unknown profile '$p'"; exit 2 }
+        foreach ($kv in $profileEnv[$p].GetEnumerator()) { Set-Item "Env:$($kv.Key)" $kv.Value }
+
+        $env:CORECLR_ENABLE_PROFILING = 1
+        $env:CORECLR_PROFILER = "{a2648b53-a560-486c-9e56-c3922a330182}"
+        $env:CORECLR_PROFILER_PATH = $profilerPath
+        $tracedOut = & $app $s --iterations $Iterations --check-stack
+        if ($LASTEXITCODE -ne 0) { $failed = 1 }
+        Remove-Item Env:CORECLR_ENABLE_PROFILING
+        foreach ($kv in $profileEnv[$p].GetEnumerator()) { Remove-Item "Env:$($kv.Key)" }
+        $traced = $tracedOut | Where-Object { $_ -like "RESULT*" }
+
+        $b = Get-Field $base "opsPerSec"
+        $t = Get-Field $traced "opsPerSec"
+        $overhead = if ($t -gt 0) { ($b / $t - 1) * 100 } else { 0 }
+        "{0,-14} {1,-8} {2,14:F0} {3,14:F0} {4,9:F1}% {5,12:F1} {6,12:F1} {7,8:F1}ms {8,8:F1}ms {9,8:F0}KB" -f $s, $p, $b, $t, $overhead, (Get-Field $base "p99Us"), (Get-Field $traced "p99Us"), (Get-Field $base "jitMs"), (Get-Field $traced "jitMs"), (Get-Field $traced "memGrowthKB")
+        $tracedOut | Where-Object { $_ -match "^(STACKCHECK|LEAKCHECK|    (expected|shadow))" } | ForEach-Object { "    " + $_ }
+    }
+}
+
+exit $failed
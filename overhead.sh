@@ -0,0 +1,68 @@
+#!/bin/bash
+# Runs each DotnetTest workload with and without the profiler and reports throughput overhead,
+# p99 iteration latency, JIT time and working-set growth. The profiled run also checks the shadow stack against
+# Environment.StackTrace and, for alc-reload, bounds working-set growth per reload. SW2TRACER_* variables are passed through to the profiled run.
+#
+#   ./overhead.sh [--iterations N] [--profiles "lean default args alloc"] [scenario ...]
+#
+# Profiles select which ELT capabilities the profiler asks the runtime for:
+#   lean     no frame info, no transitions (no ELT flags in the event mask)
+#   default  frame info and transitions
+#   args     default plus COR_PRF_ENABLE_FUNCTION_ARGS
+#   alloc    default plus allocation sampling (AllocationTick over an in-process EventPipe session)
+set -e
+
+PROFILER_PATH=${CORECLR_PROFILER_PATH:-./build/linux/x64/release/libsw2tracer.so}
+ITERATIONS=200
+PROFILES="default"
+SCENARIOS=()
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --iterations) ITERATIONS=$2; shift 2 ;;
+    --profiles) PROFILES=$2; shift 2 ;;
+    *) SCENARIOS+=("$1"); shift ;;
+  esac
+done
+
+profile_env() {
+  case "$1" in
+    lean) echo "SW2TRACER_FRAME_INFO=0 SW2TRACER_TRANSITIONS=0" ;;
+    default) echo "" ;;
+    args) echo "SW2TRACER_ARGS=1" ;;
+    alloc) echo "SW2TRACER_ALLOC=1" ;;
+    *) echo "unknown profile '$1'" >&2; exit 2 ;;
+  esac
+}
+
+dotnet build -c Release ./DotnetTest/DotnetTest.csproj -nologo -v q > /dev/null
+APP=./DotnetTest/bin/Release/net10.0/DotnetTest
+if [ ${#SCENARIOS[@]} -eq 0 ]; then
+  mapfile -t SCENARIOS < <("$APP" --list)
+fi
+
+field() { sed -n "s/.* $1=\([^ ]*\).*/\1/p"; }
+
+FAILED=0
+printf "%-14s %-8s %14s %14s %10s %12s %12s %10s %10s %10s\n" scenario profile "base ops/s" "traced ops/s" overhead "base p99us" "traced p99us" "base jit" "traced jit" "traced mem"
+for s in "${SCENARIOS[@]}"; do
+  base=$(env -u CORECLR_ENABLE_PROFILING "$APP" "$s" --iterations "$ITERATIONS" | grep '^RESULT')
+  for p in $PROFILES; do
+    extra=$(profile_env "$p")
+    # shellcheck disable=SC2086
+    traced_out=$(env $extra CORECLR_ENABLE_PROFILING=1 \
+      CORECLR_PROFILER={a2648b53-a560-486c-9e56-c3922a330182} \
+      CORECLR_PROFILER_PATH="$PROFILER_PATH" \
+      "$APP" "$s" --iterations "$ITERATIONS" --check-stack) || FAILED=1
+    traced=$(echo "$traced_out" | grep '^RESULT')
+
+    awk -v s="$s" -v p="$p" \
+      -v b="$(echo "$base" | field opsPerSec)" -v t="$(echo "$traced" | field opsPerSec)" \
+      -v bp="$(echo "$base" | field p99Us)" -v tp="$(echo "$traced" | field p99Us)" \
+      -v bj="$(echo "$base" | field jitMs)" -v tj="$(echo "$traced" | field jitMs)" \
+      -v tm="$(echo "$traced" | field memGrowthKB)" \
+      'BEGIN { printf "%-14s %-8s %14.0f %14.0f %9.1f%% %12.1f %12.1f %8.1fms %8.1fms %8.0fKB\n", s, p, b, t, (t > 0 ? (b / t - 1) * 100 : 0), bp, tp, bj, tj, tm }'
+    echo "$traced_out" | grep -E '^(STACKCHECK|LEAKCHECK|    (expected|shadow))' | sed 's/^/    /' || true
+  done
+done
+
+exit $FAILED
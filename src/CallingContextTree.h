@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "cor.h"
+#include "corprof.h"
+
+struct CallingContextNode
+{
+  FunctionID functionId = 0;
+  uint32_t parent = 0;
+  uint64_t calls = 0;
+  uint64_t inclusiveCycles = 0;
+  uint64_t exclusiveCycles = 0;
+};
+
+// Per-thread calling-context tree. Nodes are only ever appended, so a parent always has a
+// lower index than its children. Children are found through one open-addressed table keyed
+// by (parent, FunctionID) instead of per-node child lists.
+class CallingContextTree
+{
+public:
+  static constexpr uint32_t kRoot = 0;
+  // Every context past the node budget is charged here.
+  static constexpr uint32_t kOverflow = 1;
+
+  explicit CallingContextTree(uint32_t maxNodes = 16384) : m_maxNodes(maxNodes < 2 ? 2 : maxNodes)
+  {
+    m_nodes.resize(2);
+  }
+
+  uint32_t FindOrAddChild(uint32_t parent, FunctionID functionId)
+  {
+    if (parent == kOverflow)
+      return kOverflow;
+
+    if (m_table.empty())
+      m_table.assign(kInitialTableSize, 0);
+
+    size_t mask = m_table.size() - 1;
+    for (size_t slot = Hash(parent, functionId) & mask;; slot = (slot + 1) & mask)
+    {
+      uint32_t index = m_table[slot];
+      if (index == 0)
+      {
+        if (m_nodes.size() >= m_maxNodes)
+        {
+          m_dropped++;
+          return kOverflow;
+        }
+
+        index = static_cast<uint32_t>(m_nodes.size());
+        CallingContextNode node;
+        node.functionId = functionId;
+        node.parent = parent;
+        m_nodes.push_back(node);
+        m_table[slot] = index;
+        if (m_nodes.size() * 2 > m_table.size())
+          Grow();
+        return index;
+      }
+
+      const auto &node = m_nodes[index];
+      if (node.parent == parent && node.functionId == functionId)
+        return index;
+    }
+  }
+
+  // Adds every context of `other` into this tree, matching nodes by path.
+  void Merge(const CallingContextTree &other)
+  {
+    std::vector<uint32_t> mapping(other.m_nodes.size(), kOverflow);
+    mapping[kRoot] = kRoot;
+    for (uint32_t i = 2; i < other.m_nodes.size(); i++)
+    {
+      const auto &src = other.m_nodes[i];
+      mapping[i] = FindOrAddChild(mapping[src.parent], src.functionId);
+    }
+
+    for (uint32_t i = 1; i < other.m_nodes.size(); i++)
+    {
+      const auto &src = other.m_nodes[i];
+      auto &dst = m_nodes[mapping[i]];
+      dst.calls += src.calls;
+      dst.inclusiveCycles += src.inclusiveCycles;
+      dst.exclusiveCycles += src.exclusiveCycles;
+    }
+    m_dropped += other.m_dropped;
+  }
+
+  CallingContextNode &Node(uint32_t index) { return m_nodes[index]; }
+  const std::vector<CallingContextNode> &Nodes() const { return m_nodes; }
+  uint64_t Dropped() const { return m_dropped; }
+  size_t MemoryBytes() const { return m_nodes.capacity() * sizeof(CallingContextNode) + m_table.capacity() * sizeof(uint32_t); }
+
+private:
+  static constexpr size_t kInitialTableSize = 256;
+
+  static size_t Hash(uint32_t parent, FunctionID functionId)
+  {
+    uint64_t h = (static_cast<uint64_t>(functionId) ^ (static_cast<uint64_t>(parent) << 32)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h >> 20);
+  }
+
+  void Grow()
+  {
+    std::vector<uint32_t> table(m_table.size() * 2, 0);
+    size_t mask = table.size() - 1;
+    for (uint32_t index : m_table)
+    {
+      if (index == 0)
+        continue;
+      const auto &node = m_nodes[index];
+      size_t slot = Hash(node.parent, node.functionId) & mask;
+      while (table[slot] != 0)
+        slot = (slot + 1) & mask;
+      table[slot] = index;
+    }
+    m_table.swap(table);
+  }
+
+  uint32_t m_maxNodes;
+  uint64_t m_dropped = 0;
+  std::vector<CallingContextNode> m_nodes;
+  std::vector<uint32_t> m_table;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+inline bool GetEnvBool(const char *name, bool fallback)
+{
+  const char *value = std::getenv(name);
+  if (value == nullptr || value[0] == '\0')
+    return fallback;
+  return std::strcmp(value, "0") != 0 && std::strcmp(value, "false") != 0 && std::strcmp(value, "off") != 0;
+}
+
+inline uint32_t GetEnvUInt(const char *name, uint32_t fallback)
+{
+  const char *value = std::getenv(name);
+  if (value == nullptr || value[0] == '\0')
+    return fallback;
+  char *end = nullptr;
+  unsigned long parsed = std::strtoul(value, &end, 10);
+  if (end == value)
+    return fallback;
+  return static_cast<uint32_t>(parsed);
+}
+
+// Read once from SW2TRACER_* environment variables in CorProfiler::Initialize.
+struct TracerConfig
+{
+  bool callingContextTree = false;
+  uint32_t cctMaxNodes = 16384;
+  // Events per thread ring (rounded up to a power of two); 0 disables the flight recorder.
+  uint32_t flightRecorderEvents = 0;
+  uint32_t flightRecorderDumpEvents = 32;
+  // ELT capabilities requested in Initialize; the runtime does not allow changing them later.
+  // StacksArgs mode needs captureArgs. Without frameInfo, shared generic code is symbolized by its
+  // canonical instantiation. With neither, the cheaper hooks without COR_PRF_ELT_INFO are used.
+  bool captureArgs = false;
+  bool frameInfo = true;
+  // Unmanaged-to-managed transitions feed the transitions dump section and the flight recorder.
+  bool transitions = true;
+
+  // Direct recursion deeper than foldRecursionAfter frames is counted on the top frame instead
+  // of pushing more (0 disables folding). Past maxStackDepth frames, enters are only counted
+  // (0 means no cap). Together they bound per-thread memory under runaway recursion.
+  uint32_t foldRecursionAfter = 16;
+  uint32_t maxStackDepth = 16384;
+
+  // Return values of methods whose signature contains one of the comma-separated returnFilter
+  // substrings (all methods when empty) are kept in a per-thread ring of returnRecords entries.
+  bool captureReturns = false;
+  std::string returnFilter;
+  uint32_t returnRecords = 64;
+
+  // Every checkpointIntervalMs (0 disables it) a background thread rewrites one file per thread
+  // under checkpointDir for the threads whose stack changed since the previous pass.
+  uint32_t checkpointIntervalMs = 0;
+  std::string checkpointDir = "sw2tracer-checkpoint";
+  // Threads registered with SW2TracerWatchCurrentThread are polled every watchdogPollMs; a hang
+  // report goes to "<watchdogReportPrefix>-<thread>-<n>.txt".
+  uint32_t watchdogPollMs = 100;
+  std::string watchdogReportPrefix = "sw2tracer-hang";
+
+  // Calls running longer than slowCallThresholdUs are logged with their stack into a shared ring
+  // of slowCallRecords entries. slowCallFilter ("pattern[=us],...") restricts this to methods
+  // whose signature contains a pattern, each with its own threshold or the global one.
+  uint32_t slowCallThresholdUs = 0;
+  std::string slowCallFilter;
+  uint32_t slowCallRecords = 256;
+
+  // Charges the runtime's AllocationTick samples (about one per 100 KB allocated) to the top
+  // frame of the allocating thread's shadow stack.
+  bool allocationSampling = false;
+  // Records each runtime suspension for a GC (pause length, generation, reason and the stack of
+  // the thread that triggered it) into a ring of gcRecords entries.
+  bool gcTracking = false;
+  uint32_t gcRecords = 64;
+
+  // Charges each frame's exclusive time to the assembly that owns it (per-plugin cost).
+  bool assemblyTime = false;
+
+  bool WantsEventPipe() const { return allocationSampling || gcTracking; }
+
+  bool WantsEltInfo() const { return captureArgs || frameInfo || captureReturns; }
+  bool WantsSlowCalls() const { return (slowCallThresholdUs != 0 || !slowCallFilter.empty()) && slowCallRecords != 0; }
+
+  static TracerConfig FromEnvironment()
+  {
+    TracerConfig config;
+    config.callingContextTree = GetEnvBool("SW2TRACER_CCT", config.callingContextTree);
+    config.cctMaxNodes = GetEnvUInt("SW2TRACER_CCT_MAX_NODES", config.cctMaxNodes);
+    config.flightRecorderEvents = GetEnvUInt("SW2TRACER_FLIGHT_RECORDER", config.flightRecorderEvents);
+    config.flightRecorderDumpEvents = GetEnvUInt("SW2TRACER_FLIGHT_RECORDER_DUMP", config.flightRecorderDumpEvents);
+    config.captureArgs = GetEnvBool("SW2TRACER_ARGS", config.captureArgs);
+    config.frameInfo = GetEnvBool("SW2TRACER_FRAME_INFO", config.frameInfo);
+    config.transitions = GetEnvBool("SW2TRACER_TRANSITIONS", config.transitions);
+    config.foldRecursionAfter = GetEnvUInt("SW2TRACER_FOLD_AFTER", config.foldRecursionAfter);
+    config.maxStackDepth = GetEnvUInt("SW2TRACER_MAX_DEPTH", config.maxStackDepth);
+    config.captureReturns = GetEnvBool("SW2TRACER_RETVAL", config.captureReturns);
+    if (const char *filter = std::getenv("SW2TRACER_RETVAL_FILTER"))
+      config.returnFilter = filter;
+    config.returnRecords = GetEnvUInt("SW2TRACER_RETVAL_RECORDS", config.returnRecords);
+    config.checkpointIntervalMs = GetEnvUInt("SW2TRACER_CHECKPOINT_MS", config.checkpointIntervalMs);
+    if (const char *dir = std::getenv("SW2TRACER_CHECKPOINT_DIR"); dir != nullptr && dir[0] != '\0')
+      config.checkpointDir = dir;
+    config.watchdogPollMs = GetEnvUInt("SW2TRACER_WATCHDOG_POLL_MS", config.watchdogPollMs);
+    if (const char *prefix = std::getenv("SW2TRACER_WATCHDOG_REPORT"); prefix != nullptr && prefix[0] != '\0')
+      config.watchdogReportPrefix = prefix;
+    config.slowCallThresholdUs = GetEnvUInt("SW2TRACER_SLOW_CALL_US", config.slowCallThresholdUs);
+    if (const char *filter = std::getenv("SW2TRACER_SLOW_CALL_FILTER"))
+      config.slowCallFilter = filter;
+    config.slowCallRecords = GetEnvUInt("SW2TRACER_SLOW_CALL_RECORDS", config.slowCallRecords);
+    config.allocationSampling = GetEnvBool("SW2TRACER_ALLOC", config.allocationSampling);
+    config.gcTracking = GetEnvBool("SW2TRACER_GC", config.gcTracking);
+    config.gcRecords = GetEnvUInt("SW2TRACER_GC_RECORDS", config.gcRecords);
+    config.assemblyTime = GetEnvBool("SW2TRACER_ASSEMBLY_TIME", config.assemblyTime);
+    return config;
+  }
+};
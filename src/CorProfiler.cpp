@@ -7,25 +7,32 @@
 #include "Logger.h"
 
 #include "StackManager.h"
+#include <cstring>
 #include <string>
 
 #include "corhlpr.h"
 #include "ProfilerPal.h"
 
 
-PROFILER_STUB EnterStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo)
+PROFILER_STUB EnterStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
-  GlobalStackManager()->FunctionEnter(functionId, eltInfo);
+  if (!IsTracingEnabled())
+    return;
+  GlobalStackManager()->FunctionEnter(functionId, eltInfo, stackPointer);
 }
 
-PROFILER_STUB LeaveStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo)
+PROFILER_STUB LeaveStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
-  GlobalStackManager()->FunctionLeave(functionId, eltInfo);
+  if (!IsTracingEnabled())
+    return;
+  GlobalStackManager()->FunctionLeave(functionId, eltInfo, stackPointer);
 }
 
-PROFILER_STUB TailcallStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo)
+PROFILER_STUB TailcallStub(FunctionIDOrClientID functionId, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
-  GlobalStackManager()->FunctionTailcall(functionId, eltInfo);
+  if (!IsTracingEnabled())
+    return;
+  GlobalStackManager()->FunctionTailcall(functionId, eltInfo, stackPointer);
 }
 
 // ASM
@@ -33,7 +40,7 @@ EXTERN_C void EnterNaked(FunctionIDOrClientID functionIDOrClientID, COR_PRF_ELT_
 EXTERN_C void LeaveNaked(FunctionIDOrClientID functionIDOrClientID, COR_PRF_ELT_INFO eltInfo);
 EXTERN_C void TailcallNaked(FunctionIDOrClientID functionIDOrClientID, COR_PRF_ELT_INFO eltInfo);
 
-CorProfiler::CorProfiler() : refCount(0), corProfilerInfo(nullptr)
+CorProfiler::CorProfiler() : refCount(0), corProfilerInfo(nullptr), eventPipeSession(0)
 {
 }
 
@@ -55,40 +62,150 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown *pICorProfilerInfoUnk
     return E_FAIL;
   }
 
+  // Before any hook can log: the writer thread must not be created on a hook thread.
+  GlobalLogger().Start();
+
+  const TracerConfig config = TracerConfig::FromEnvironment();
+  GlobalStackManager()->SetConfig(config);
   GlobalStackManager()->SetCorProfilerInfo(this->corProfilerInfo);
 
+  // Every ENABLE_* flag makes the JIT emit heavier ELT probes, so only ask for what is used.
   DWORD eventMask =
       COR_PRF_MONITOR_ENTERLEAVE |
       COR_PRF_MONITOR_THREADS |
-      COR_PRF_MONITOR_CODE_TRANSITIONS |
-      COR_PRF_ENABLE_FUNCTION_ARGS |
-      COR_PRF_ENABLE_FUNCTION_RETVAL |
-      COR_PRF_ENABLE_FRAME_INFO;
+      COR_PRF_MONITOR_EXCEPTIONS |
+      // Unload notifications for evicting symbol data of collectible contexts.
+      COR_PRF_MONITOR_MODULE_LOADS |
+      COR_PRF_MONITOR_ASSEMBLY_LOADS |
+      COR_PRF_MONITOR_FUNCTION_UNLOADS;
+  if (config.transitions)
+    eventMask |= COR_PRF_MONITOR_CODE_TRANSITIONS;
+  if (config.captureArgs)
+    eventMask |= COR_PRF_ENABLE_FUNCTION_ARGS;
+  if (config.frameInfo)
+    eventMask |= COR_PRF_ENABLE_FRAME_INFO;
+  if (config.captureReturns)
+    eventMask |= COR_PRF_ENABLE_FUNCTION_RETVAL;
+  // Suspend/resume callbacks time GC pauses; COR_PRF_MONITOR_GC is avoided because it turns off
+  // concurrent GC. Generation and reason come from the GCStart event instead.
+  if (config.gcTracking)
+    eventMask |= COR_PRF_MONITOR_SUSPENDS;
+
+  DWORD highEventMask = COR_PRF_HIGH_MONITOR_NONE;
+  if (config.WantsEventPipe())
+    highEventMask |= COR_PRF_HIGH_MONITOR_EVENT_PIPE;
 
-  auto hr = this->corProfilerInfo->SetEventMask(eventMask);
+  auto hr = this->corProfilerInfo->SetEventMask2(eventMask, highEventMask);
   if (hr != S_OK)
   {
-    LOG("ERROR: Profiler SetEventMask failed (HRESULT: 0x%08X)", (unsigned)hr);
+    LOG("ERROR: Profiler SetEventMask2 failed (HRESULT: 0x%08X)", (unsigned)hr);
   }
 
+  // Always the WithInfo hooks, which the runtime reaches through its own register-saving
+  // helpers. Without ELT flags in the mask FunctionEnter does not query the frame info, so lean
+  // still saves the heavier probes.
   hr = this->corProfilerInfo->SetEnterLeaveFunctionHooks3WithInfo(EnterNaked, LeaveNaked, TailcallNaked);
-
   if (hr != S_OK)
   {
     LOG("ERROR: Profiler SetEnterLeaveFunctionHooks3WithInfo failed (HRESULT: 0x%08X)", (unsigned)hr);
   }
 
+  LOG("Event mask 0x%08X (args=%d frameInfo=%d transitions=%d retval=%d)", (unsigned)eventMask, config.captureArgs ? 1 : 0, config.frameInfo ? 1 : 0, config.transitions ? 1 : 0, config.captureReturns ? 1 : 0);
+
+  GlobalStackManager()->StartCheckpoints();
+  if (config.WantsEventPipe())
+    StartEventPipeSession(config);
+
+  return S_OK;
+}
+
+// AllocationTick fires about once per 100 KB allocated, on the allocating thread, so its cost
+// does not grow with the allocation rate. ObjectAllocated would fire for every object and make
+// the JIT drop its inline allocation helpers. GCStart is informational; AllocationTick needs the
+// verbose level.
+void CorProfiler::StartEventPipeSession(const TracerConfig &config)
+{
+  static constexpr UINT64 kGcKeyword = 0x1;
+  static constexpr UINT32 kInformationalLevel = 4;
+  static constexpr UINT32 kVerboseLevel = 5;
+  COR_PRF_EVENTPIPE_PROVIDER_CONFIG provider{
+      reinterpret_cast<const WCHAR *>(u"Microsoft-Windows-DotNETRuntime"), kGcKeyword,
+      config.allocationSampling ? kVerboseLevel : kInformationalLevel, nullptr};
+
+  HRESULT hr = this->corProfilerInfo->EventPipeStartSession(1, &provider, FALSE, &this->eventPipeSession);
+  if (FAILED(hr))
+  {
+    this->eventPipeSession = 0;
+    LOG("ERROR: EventPipeStartSession failed (HRESULT: 0x%08X); no allocation samples or GC generations/reasons", (unsigned)hr);
+    return;
+  }
+  LOG("EventPipe session on (allocations=%d gc=%d)", config.allocationSampling ? 1 : 0, config.gcTracking ? 1 : 0);
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::EventPipeEventDelivered(EVENTPIPE_PROVIDER provider, DWORD eventId, DWORD eventVersion, ULONG cbMetadataBlob, LPCBYTE metadataBlob, ULONG cbEventData, LPCBYTE eventData, LPCGUID pActivityId, LPCGUID pRelatedActivityId, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[])
+{
+  // Only the GC keyword is enabled. GCStart payload: Count (u32), Depth (u32), Reason (u32), ...
+  static constexpr DWORD kGcStartEventId = 1;
+  if (eventId == kGcStartEventId && eventData != nullptr && cbEventData >= 3 * sizeof(uint32_t))
+  {
+    uint32_t fields[3];
+    std::memcpy(fields, eventData, sizeof(fields));
+    GlobalStackManager()->OnGcStart(fields[0], fields[1], fields[2]);
+    return S_OK;
+  }
+
+  // GCAllocationTick is used from V2 on (the first version that names the type). Payload:
+  // AllocationAmount (u32), AllocationKind (u32), ClrInstanceID (u16), AllocationAmount64 (u64),
+  // TypeID (pointer), TypeName (UTF-16).
+  static constexpr DWORD kAllocationTickEventId = 10;
+  if (eventId != kAllocationTickEventId || eventVersion < 2 || eventData == nullptr || !GlobalStackManager()->GetConfig().allocationSampling)
+    return S_OK;
+
+  static constexpr ULONG kAmountOffset = 10;
+  static constexpr ULONG kTypeIdOffset = kAmountOffset + sizeof(uint64_t);
+  static constexpr ULONG kTypeNameOffset = kTypeIdOffset + sizeof(UINT_PTR);
+  if (cbEventData < kTypeNameOffset)
+    return S_OK;
+
+  // The TypeID is skipped: types are kept by name, which stays the same across reloads.
+  uint64_t bytes = 0;
+  std::memcpy(&bytes, eventData + kAmountOffset, sizeof(bytes));
+
+  // The payload is packed, so the string may be unaligned.
+  std::basic_string<WCHAR> typeName;
+  for (ULONG offset = kTypeNameOffset; offset + sizeof(WCHAR) <= cbEventData; offset += sizeof(WCHAR))
+  {
+    WCHAR c;
+    std::memcpy(&c, eventData + offset, sizeof(c));
+    if (c == 0)
+      break;
+    typeName.push_back(c);
+  }
+
+  GlobalStackManager()->OnAllocationSample(eventThread, typeName, bytes);
   return S_OK;
 }
 
 HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown()
 {
+  // The checkpointer and the watchdog format values through corProfilerInfo; stop them before
+  // that goes away.
+  GlobalStackManager()->StopWatchdog();
+  GlobalStackManager()->StopCheckpoints();
+
   if (this->corProfilerInfo != nullptr)
   {
+    if (this->eventPipeSession != 0)
+    {
+      this->corProfilerInfo->EventPipeStopSession(this->eventPipeSession);
+      this->eventPipeSession = 0;
+    }
     this->corProfilerInfo->Release();
     this->corProfilerInfo = nullptr;
   }
 
+  GlobalLogger().Stop();
+
   return S_OK;
 }
 
@@ -110,8 +227,70 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ThreadAssignedToOSThread(ThreadID managed
   return S_OK;
 }
 
+HRESULT STDMETHODCALLTYPE CorProfiler::ThreadNameChanged(ThreadID threadId, ULONG cchName, WCHAR name[])
+{
+  GlobalStackManager()->OnThreadNameChanged(threadId, name, cchName);
+  return S_OK;
+}
+
 HRESULT STDMETHODCALLTYPE CorProfiler::UnmanagedToManagedTransition(FunctionID functionId, COR_PRF_TRANSITION_REASON reason)
 {
   GlobalStackManager()->OnUnmanagedToManaged(functionId, reason);
   return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ExceptionUnwindFunctionEnter(FunctionID functionId)
+{
+  if (IsTracingEnabled())
+    GlobalStackManager()->OnExceptionUnwindFunctionEnter(functionId);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ExceptionUnwindFunctionLeave()
+{
+  if (IsTracingEnabled())
+    GlobalStackManager()->OnExceptionUnwindFunctionLeave();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::FunctionUnloadStarted(FunctionID functionId)
+{
+  GlobalStackManager()->OnFunctionUnloadStarted(functionId);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID moduleId)
+{
+  GlobalStackManager()->OnModuleUnloadStarted(moduleId);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadFinished(ModuleID moduleId, HRESULT hrStatus)
+{
+  GlobalStackManager()->OnModuleUnloadFinished(moduleId);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::AssemblyUnloadFinished(AssemblyID assemblyId, HRESULT hrStatus)
+{
+  GlobalStackManager()->OnAssemblyUnloadFinished(assemblyId);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason)
+{
+  GlobalStackManager()->OnRuntimeSuspendStarted(suspendReason);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeSuspendAborted()
+{
+  GlobalStackManager()->OnRuntimeSuspendAborted();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CorProfiler::RuntimeResumeFinished()
+{
+  GlobalStackManager()->OnRuntimeResumeFinished();
+  return S_OK;
 }
\ No newline at end of file
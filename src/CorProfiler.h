@@ -5,16 +5,21 @@
 #endif
 #include <atomic>
 #include "Helper.h"
+#include "Config.h"
 #include "Logger.h"
 #include "cor.h"
 #include "corprof.h"
 
 
-class CorProfiler : ICorProfilerCallback9
+class CorProfiler : ICorProfilerCallback10
 {
 private:
   std::atomic<int> refCount;
   ICorProfilerInfo15 *corProfilerInfo;
+  // In-process EventPipe session feeding allocation sampling and GC tracking; 0 when none is running.
+  EVENTPIPE_SESSION eventPipeSession;
+
+  void StartEventPipeSession(const TracerConfig &config);
 
 public:
   CorProfiler();
@@ -23,6 +28,7 @@ public:
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override
   {
     if (
+        riid == __uuidof(ICorProfilerCallback10) ||
         riid == __uuidof(ICorProfilerCallback9) ||
         riid == __uuidof(ICorProfilerCallback8) ||
         riid == __uuidof(ICorProfilerCallback7) ||
@@ -69,17 +75,17 @@ public:
   HRESULT STDMETHODCALLTYPE AssemblyLoadStarted(AssemblyID assemblyId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE AssemblyLoadFinished(AssemblyID assemblyId, HRESULT hrStatus) { return S_OK; };
   HRESULT STDMETHODCALLTYPE AssemblyUnloadStarted(AssemblyID assemblyId) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE AssemblyUnloadFinished(AssemblyID assemblyId, HRESULT hrStatus) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE AssemblyUnloadFinished(AssemblyID assemblyId, HRESULT hrStatus) override;
   HRESULT STDMETHODCALLTYPE ModuleLoadStarted(ModuleID moduleId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ModuleLoadFinished(ModuleID moduleId, HRESULT hrStatus) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE ModuleUnloadStarted(ModuleID moduleId) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE ModuleUnloadFinished(ModuleID moduleId, HRESULT hrStatus) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE ModuleUnloadStarted(ModuleID moduleId) override;
+  HRESULT STDMETHODCALLTYPE ModuleUnloadFinished(ModuleID moduleId, HRESULT hrStatus) override;
   HRESULT STDMETHODCALLTYPE ModuleAttachedToAssembly(ModuleID moduleId, AssemblyID AssemblyId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ClassLoadStarted(ClassID classId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ClassLoadFinished(ClassID classId, HRESULT hrStatus) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ClassUnloadStarted(ClassID classId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ClassUnloadFinished(ClassID classId, HRESULT hrStatus) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE FunctionUnloadStarted(FunctionID functionId) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE FunctionUnloadStarted(FunctionID functionId) override;
   HRESULT STDMETHODCALLTYPE JITCompilationStarted(FunctionID functionId, BOOL fIsSafeToBlock) { return S_OK; };
   HRESULT STDMETHODCALLTYPE JITCompilationFinished(FunctionID functionId, HRESULT hrStatus, BOOL fIsSafeToBlock) { return S_OK; };
   HRESULT STDMETHODCALLTYPE JITCachedFunctionSearchStarted(FunctionID functionId, BOOL *pbUseCachedFunction) { return S_OK; };
@@ -99,11 +105,11 @@ public:
   HRESULT STDMETHODCALLTYPE RemotingServerSendingReply(GUID *pCookie, BOOL fIsAsync) { return S_OK; };
   HRESULT STDMETHODCALLTYPE UnmanagedToManagedTransition(FunctionID functionId, COR_PRF_TRANSITION_REASON reason) override;
   HRESULT STDMETHODCALLTYPE ManagedToUnmanagedTransition(FunctionID functionId, COR_PRF_TRANSITION_REASON reason) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason) override;
   HRESULT STDMETHODCALLTYPE RuntimeSuspendFinished(void) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE RuntimeSuspendAborted(void) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE RuntimeSuspendAborted(void) override;
   HRESULT STDMETHODCALLTYPE RuntimeResumeStarted(void) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE RuntimeResumeFinished(void) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE RuntimeResumeFinished(void) override;
   HRESULT STDMETHODCALLTYPE RuntimeThreadSuspended(ThreadID threadId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE RuntimeThreadResumed(ThreadID threadId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE MovedReferences(ULONG cMovedObjectIDRanges, ObjectID oldObjectIDRangeStart[], ObjectID newObjectIDRangeStart[], ULONG cObjectIDRangeLength[]) { return S_OK; };
@@ -119,8 +125,8 @@ public:
   HRESULT STDMETHODCALLTYPE ExceptionSearchCatcherFound(FunctionID functionId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionOSHandlerEnter(UINT_PTR __unused) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionOSHandlerLeave(UINT_PTR __unused) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE ExceptionUnwindFunctionEnter(FunctionID functionId) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE ExceptionUnwindFunctionLeave(void) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE ExceptionUnwindFunctionEnter(FunctionID functionId) override;
+  HRESULT STDMETHODCALLTYPE ExceptionUnwindFunctionLeave(void) override;
   HRESULT STDMETHODCALLTYPE ExceptionUnwindFinallyEnter(FunctionID functionId) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionUnwindFinallyLeave(void) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionCatcherEnter(FunctionID functionId, ObjectID objectId) { return S_OK; };
@@ -129,7 +135,7 @@ public:
   HRESULT STDMETHODCALLTYPE COMClassicVTableDestroyed(ClassID wrappedClassId, REFGUID implementedIID, void *pVTable) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionCLRCatcherFound(void) { return S_OK; };
   HRESULT STDMETHODCALLTYPE ExceptionCLRCatcherExecute(void) { return S_OK; };
-  HRESULT STDMETHODCALLTYPE ThreadNameChanged(ThreadID threadId, ULONG cchName, WCHAR name[]) override { return S_OK; };
+  HRESULT STDMETHODCALLTYPE ThreadNameChanged(ThreadID threadId, ULONG cchName, WCHAR name[]) override;
   HRESULT STDMETHODCALLTYPE GarbageCollectionStarted(int cGenerations, BOOL generationCollected[], COR_PRF_GC_REASON reason) { return S_OK; };
   HRESULT STDMETHODCALLTYPE SurvivingReferences(ULONG cSurvivingObjectIDRanges, ObjectID objectIDRangeStart[], ULONG cObjectIDRangeLength[]) { return S_OK; };
   HRESULT STDMETHODCALLTYPE GarbageCollectionFinished(void) { return S_OK; };
@@ -152,4 +158,6 @@ public:
   HRESULT STDMETHODCALLTYPE DynamicMethodJITCompilationStarted(FunctionID functionId, BOOL fIsSafeToBlock, LPCBYTE pILHeader, ULONG cbILHeader) { return S_OK; };
   HRESULT STDMETHODCALLTYPE DynamicMethodJITCompilationFinished(FunctionID functionId, HRESULT hrStatus, BOOL fIsSafeToBlock) { return S_OK; };
   HRESULT STDMETHODCALLTYPE DynamicMethodUnloaded(FunctionID functionId) { return S_OK; };
+  HRESULT STDMETHODCALLTYPE EventPipeEventDelivered(EVENTPIPE_PROVIDER provider, DWORD eventId, DWORD eventVersion, ULONG cbMetadataBlob, LPCBYTE metadataBlob, ULONG cbEventData, LPCBYTE eventData, LPCGUID pActivityId, LPCGUID pRelatedActivityId, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[]) override;
+  HRESULT STDMETHODCALLTYPE EventPipeProviderCreated(EVENTPIPE_PROVIDER provider) { return S_OK; };
 };
\ No newline at end of file
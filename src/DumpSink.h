@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <streambuf>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Stream buffer behind the non-file dump exports. Text is collected in a fixed buffer and handed
+// to the sink in chunks of up to kChunkBytes, so a dump costs a handful of writes instead of one
+// per line. Once the sink fails, further output is discarded and Failed() reports it.
+//
+// The buffer is static rather than a member: the exports run from crash handlers, possibly on a
+// small alternate stack, and must not put 64 KB on it. It is shared, so only one sink may be
+// written at a time; the exports ensure that with g_dumpInProgress.
+class DumpSinkBuf : public std::streambuf
+{
+public:
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  DumpSinkBuf() { setp(s_buffer, s_buffer + kChunkBytes); }
+  DumpSinkBuf(const DumpSinkBuf &) = delete;
+  DumpSinkBuf &operator=(const DumpSinkBuf &) = delete;
+
+  // Writes out what is still buffered. Call before reading the result; the destructor of a
+  // derived sink runs too late for that.
+  bool Finish()
+  {
+    FlushBuffer();
+    return !m_failed;
+  }
+
+  bool Failed() const { return m_failed; }
+
+protected:
+  // Takes one chunk; returns false to stop the dump.
+  virtual bool Emit(const char *data, size_t size) = 0;
+
+  int_type overflow(int_type ch) override
+  {
+    FlushBuffer();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return m_failed ? traits_type::eof() : traits_type::not_eof(ch);
+  }
+
+  int sync() override
+  {
+    FlushBuffer();
+    return m_failed ? -1 : 0;
+  }
+
+private:
+  void FlushBuffer()
+  {
+    const size_t size = static_cast<size_t>(pptr() - pbase());
+    if (size != 0 && !m_failed && !Emit(pbase(), size))
+      m_failed = true;
+    setp(s_buffer, s_buffer + kChunkBytes);
+  }
+
+  static inline char s_buffer[kChunkBytes];
+  bool m_failed = false;
+};
+
+// Writes to a descriptor the caller opened (a pipe to a crash reporter, a socket); never closes it.
+class FdDumpSink : public DumpSinkBuf
+{
+public:
+  explicit FdDumpSink(int fd) : m_fd(fd) {}
+
+protected:
+  bool Emit(const char *data, size_t size) override
+  {
+    while (size != 0)
+    {
+#if defined(_WIN32)
+      int n = _write(m_fd, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30)));
+#else
+      ssize_t n = ::write(m_fd, data, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+#endif
+      if (n <= 0)
+        return false;
+      data += n;
+      size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+private:
+  int m_fd;
+};
+
+// Fills a caller-provided region. Output past the end is counted but not stored, so Required()
+// tells the caller how large a buffer the whole dump needs.
+class MemoryDumpSink : public DumpSinkBuf
+{
+public:
+  MemoryDumpSink(char *buffer, size_t capacity) : m_buffer(buffer), m_capacity(capacity) {}
+
+  uint64_t Required() const { return m_required; }
+
+protected:
+  bool Emit(const char *data, size_t size) override
+  {
+    if (m_required < m_capacity)
+    {
+      const size_t n = std::min<size_t>(size, m_capacity - static_cast<size_t>(m_required));
+      std::memcpy(m_buffer + m_required, data, n);
+    }
+    m_required += size;
+    return true;
+  }
+
+private:
+  char *m_buffer;
+  size_t m_capacity;
+  uint64_t m_required = 0;
+};
+
+// Returns nonzero to receive more, 0 to stop the dump. data is only valid during the call.
+typedef int (*SW2TracerDumpCallback)(const char *data, size_t size, void *context);
+
+class CallbackDumpSink : public DumpSinkBuf
+{
+public:
+  CallbackDumpSink(SW2TracerDumpCallback callback, void *context) : m_callback(callback), m_context(context) {}
+
+protected:
+  bool Emit(const char *data, size_t size) override
+  {
+    return m_callback(data, size, m_context) != 0;
+  }
+
+private:
+  SW2TracerDumpCallback m_callback;
+  void *m_context;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "DumpSink.h"
 #include "StackManager.h"
 #include <atomic>
+#include <ostream>
 
 #ifndef _WIN32
 #define EXPORT_API extern "C" __attribute__((visibility("default")))
@@ -18,16 +20,162 @@ struct DumpGuard
     }
 };
 
+// One stack dump at a time, whichever sink it goes to.
+inline std::atomic_flag g_dumpInProgress = ATOMIC_FLAG_INIT;
+
 EXPORT_API void SW2TracerDump(const char *path)
 {
     if (path == nullptr || path[0] == '\0')
         return;
 
-    static std::atomic_flag dumpInProgress = ATOMIC_FLAG_INIT;
-    if (dumpInProgress.test_and_set(std::memory_order_acquire))
+    if (g_dumpInProgress.test_and_set(std::memory_order_acquire))
         return;
 
-    DumpGuard guard{dumpInProgress};
+    DumpGuard guard{g_dumpInProgress};
 
     GlobalStackManager()->Dump(path);
+}
+
+// Same text as SW2TracerDump, streamed in large chunks to a sink the caller already has, for when
+// opening a file is not an option (crash handling, full disk).
+inline bool DumpToSink(DumpSinkBuf &sink)
+{
+    std::ostream out(&sink);
+    GlobalStackManager()->WriteDump(out);
+    return sink.Finish();
+}
+
+// Writes the dump to an open descriptor (a pipe or socket) and leaves it open. Returns 1 when
+// every byte was written, 0 on a write error or while another dump is running.
+EXPORT_API int SW2TracerDumpToFd(int fd)
+{
+    if (fd < 0 || g_dumpInProgress.test_and_set(std::memory_order_acquire))
+        return 0;
+
+    DumpGuard guard{g_dumpInProgress};
+    FdDumpSink sink(fd);
+    return DumpToSink(sink) ? 1 : 0;
+}
+
+// Writes the dump into buffer without terminating it. Returns the size of the whole dump, which
+// exceeds capacity when it was cut short, or -1 while another dump is running.
+EXPORT_API int64_t SW2TracerDumpToBuffer(char *buffer, uint64_t capacity)
+{
+    if (buffer == nullptr)
+        capacity = 0;
+    if (g_dumpInProgress.test_and_set(std::memory_order_acquire))
+        return -1;
+
+    DumpGuard guard{g_dumpInProgress};
+    MemoryDumpSink sink(buffer, static_cast<size_t>(capacity));
+    DumpToSink(sink);
+    return static_cast<int64_t>(sink.Required());
+}
+
+// Hands the dump to callback in chunks of up to 64 KB. Returns 1 when the callback took all of
+// it, 0 when it stopped the dump or another dump is running.
+EXPORT_API int SW2TracerDumpToCallback(SW2TracerDumpCallback callback, void *context)
+{
+    if (callback == nullptr || g_dumpInProgress.test_and_set(std::memory_order_acquire))
+        return 0;
+
+    DumpGuard guard{g_dumpInProgress};
+    CallbackDumpSink sink(callback, context);
+    return DumpToSink(sink) ? 1 : 0;
+}
+
+// mode: 0 = off, 1 = stacks, 2 = stacks + args, 3 = timing. Returns 1 on success.
+EXPORT_API int SW2TracerSetMode(int mode)
+{
+    if (mode < 0)
+        return 0;
+
+    return GlobalStackManager()->SetMode(static_cast<TracerMode>(mode)) ? 1 : 0;
+}
+
+EXPORT_API int SW2TracerGetMode()
+{
+    return static_cast<int>(GlobalStackManager()->GetMode());
+}
+
+// Caller sets stats->size = sizeof(SW2TracerStats); counters are totals since startup.
+EXPORT_API int SW2TracerGetStats(SW2TracerStats *stats)
+{
+    if (stats == nullptr || stats->size < sizeof(uint32_t))
+        return 0;
+
+    GlobalStackManager()->GetStats(*stats);
+    return 1;
+}
+
+// Requires SW2TRACER_CCT=1. weightByTime: 0 = self call counts, 1 = exclusive nanoseconds (timing mode).
+EXPORT_API void SW2TracerDumpCollapsedStacks(const char *path, int weightByTime)
+{
+    if (path == nullptr || path[0] == '\0')
+        return;
+
+    GlobalStackManager()->DumpCollapsedStacks(path, weightByTime != 0);
+}
+
+// Requires SW2TRACER_FLIGHT_RECORDER=<events per thread>. Writes Chrome Trace Event JSON.
+EXPORT_API void SW2TracerDumpTrace(const char *path, int maxEventsPerThread)
+{
+    if (path == nullptr || path[0] == '\0' || maxEventsPerThread <= 0)
+        return;
+
+    GlobalStackManager()->DumpTrace(path, static_cast<size_t>(maxEventsPerThread));
+}
+
+// Call from the frame that drives the thread (e.g. the game loop). A hang report is written when
+// the thread makes no progress for thresholdMs, or when a method called from that frame stays
+// active that long. thresholdMs 0 stops watching. Returns 1 on success.
+EXPORT_API int SW2TracerWatchCurrentThread(int thresholdMs)
+{
+    if (thresholdMs < 0)
+        return 0;
+
+    return GlobalStackManager()->WatchCurrentThread(static_cast<uint32_t>(thresholdMs)) ? 1 : 0;
+}
+
+// Requires SW2TRACER_SLOW_CALL_US or SW2TRACER_SLOW_CALL_FILTER. Fills up to maxCalls entries,
+// most recent first, and returns how many were written.
+EXPORT_API int SW2TracerGetSlowCalls(SW2TracerSlowCall *calls, int maxCalls)
+{
+    if (calls == nullptr || maxCalls <= 0)
+        return 0;
+
+    return static_cast<int>(GlobalStackManager()->GetSlowCalls(calls, static_cast<size_t>(maxCalls)));
+}
+
+// Copies the shadow stack of threadId (the runtime ThreadID shown in dumps; 0 for the calling
+// thread) into frames, innermost first. Allocates nothing and touches no files, so it can run in
+// an error handler. Returns how many frames were written; depth, when not null, receives the
+// full stack depth. Frame names are interned and stay valid for the life of the process.
+EXPORT_API int SW2TracerGetStack(uint64_t threadId, SW2TracerFrame *frames, int maxFrames, int *depth)
+{
+    size_t fullDepth = 0;
+    size_t written = GlobalStackManager()->GetStack(static_cast<ThreadID>(threadId), frames, maxFrames > 0 ? static_cast<size_t>(maxFrames) : 0, &fullDepth);
+    if (depth != nullptr)
+        *depth = static_cast<int>(fullDepth);
+    return static_cast<int>(written);
+}
+
+// Resolves a FunctionID reported by SW2TracerGetSlowCalls, a dump or a trace. Returns 1 and fills
+// frame when the method is known, 0 when it was never entered or its module has been unloaded.
+EXPORT_API int SW2TracerLookupFunction(uint64_t functionId, SW2TracerFrame *frame)
+{
+    if (frame == nullptr)
+        return 0;
+
+    return GlobalStackManager()->LookupFunction(static_cast<FunctionID>(functionId), *frame) ? 1 : 0;
+}
+
+// Requires SW2TRACER_ASSEMBLY_TIME=1. Fills up to maxEntries entries, busiest assembly first, and
+// returns how many were written.
+EXPORT_API int SW2TracerGetAssemblyTime(SW2TracerAssemblyTime *entries, int maxEntries)
+{
+    if (entries == nullptr || maxEntries <= 0)
+        return 0;
+
+    return static_cast<int>(GlobalStackManager()->GetAssemblyTime(entries, static_cast<size_t>(maxEntries)));
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "cor.h"
+#include "corprof.h"
+
+enum class FlightEventKind : uint8_t
+{
+  Enter = 0,
+  Leave = 1,
+  Tailcall = 2,
+  TransitionCall = 3,
+  TransitionReturn = 4,
+  Unwind = 5,
+};
+
+// 16 bytes: the kind lives in the top 4 bits of the timestamp word, which leaves 60 bits of TSC.
+struct FlightEvent
+{
+  FunctionID functionId;
+  uint64_t tscAndKind;
+
+  uint64_t Tsc() const { return tscAndKind & ((1ull << 60) - 1); }
+  FlightEventKind Kind() const { return static_cast<FlightEventKind>(tscAndKind >> 60); }
+};
+
+// Compact return value captured in FunctionLeave (SW2TRACER_RETVAL); formatted only at dump time.
+// value holds the raw bits of primitive returns, the ClassID of reference returns (0 for null),
+// and the first four UTF-16 code units of strings, whose full length goes in length.
+struct ReturnRecord
+{
+  FunctionID functionId;
+  uint64_t tsc;
+  uint64_t value;
+  uint32_t length;
+  uint8_t elementType;
+  uint8_t isNull;
+};
+
+// One runtime suspension for a GC (SW2TRACER_GC), from RuntimeSuspendStarted to
+// RuntimeResumeFinished. generation and reason come from the GCStart event and are -1 when it
+// did not arrive. frames holds the triggering thread's shadow stack, top first, when that thread
+// is a managed one (not for server or background GC threads).
+struct GcPauseRecord
+{
+  static constexpr uint32_t kMaxFrames = 16;
+
+  uint64_t suspendTsc;
+  uint64_t resumeTsc;
+  ThreadID triggerThread;
+  uint32_t gcIndex;
+  int32_t generation;
+  int32_t reason;
+  uint32_t frameCount;
+  FunctionID frames[kMaxFrames];
+};
+
+// Single-writer ring owned by one managed thread. Only the owner pushes, so the hot path is a
+// few relaxed stores plus a release store of the head; readers copy and discard whatever the
+// writer may have lapped while they were copying. Slots are stored as words of relaxed atomics
+// so that the copy racing an overwrite is a torn value that gets discarded, not a data race.
+template <typename Event>
+class SingleWriterRing
+{
+  static_assert(std::is_trivially_copyable_v<Event> && sizeof(Event) % sizeof(uint64_t) == 0);
+  static constexpr size_t kWords = sizeof(Event) / sizeof(uint64_t);
+
+public:
+  explicit SingleWriterRing(uint32_t capacity)
+  {
+    uint32_t size = 16;
+    while (size < capacity && size < (1u << 24))
+      size <<= 1;
+    m_mask = size - 1;
+    m_words = std::make_unique<std::atomic<uint64_t>[]>(static_cast<size_t>(size) * kWords);
+  }
+
+  void Push(const Event &event)
+  {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    uint64_t words[kWords];
+    std::memcpy(words, &event, sizeof(Event));
+    // Orders the previous head store before these slot stores: a reader that sees any of them
+    // also sees a head that marks this slot as being rewritten.
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic<uint64_t> *slot = &m_words[(head & m_mask) * kWords];
+    for (size_t i = 0; i < kWords; i++)
+      slot[i].store(words[i], std::memory_order_relaxed);
+    m_head.store(head + 1, std::memory_order_release);
+  }
+
+  // Oldest first, at most maxEvents of the most recent events.
+  std::vector<Event> Snapshot(size_t maxEvents) const
+  {
+    const uint64_t capacity = static_cast<uint64_t>(m_mask) + 1;
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>({head, capacity, static_cast<uint64_t>(maxEvents)});
+
+    std::vector<Event> out(static_cast<size_t>(count));
+    for (uint64_t i = head - count; i < head; i++)
+    {
+      const std::atomic<uint64_t> *slot = &m_words[(i & m_mask) * kWords];
+      uint64_t words[kWords];
+      for (size_t w = 0; w < kWords; w++)
+        words[w] = slot[w].load(std::memory_order_relaxed);
+      std::memcpy(&out[static_cast<size_t>(i - (head - count))], words, sizeof(Event));
+    }
+
+    // Once the head reads `after`, the owner may already be rewriting slot `after`, which is
+    // where event after - capacity lived, so only events from after - capacity + 1 are intact.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = m_head.load(std::memory_order_relaxed);
+    uint64_t firstValid = after >= capacity ? after - capacity + 1 : 0;
+    if (firstValid > head - count)
+    {
+      size_t overwritten = static_cast<size_t>(std::min<uint64_t>(firstValid - (head - count), out.size()));
+      out.erase(out.begin(), out.begin() + overwritten);
+    }
+    return out;
+  }
+
+private:
+  std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+  uint32_t m_mask = 0;
+  std::atomic<uint64_t> m_head{0};
+};
+
+class FlightRecorder : public SingleWriterRing<FlightEvent>
+{
+public:
+  using SingleWriterRing::SingleWriterRing;
+
+  void Record(FlightEventKind kind, FunctionID functionId, uint64_t tsc)
+  {
+    Push(FlightEvent{functionId, (tsc & ((1ull << 60) - 1)) | (static_cast<uint64_t>(kind) << 60)});
+  }
+};
+
+using ReturnRecorder = SingleWriterRing<ReturnRecord>;
+// The runtime runs one GC at a time, so GC pauses also have a single writer.
+using GcPauseRecorder = SingleWriterRing<GcPauseRecord>;
@@ -155,7 +155,7 @@ inline void GetTypeName2(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataI
 }
 
 inline std::string GetTypeNameFromTypeToken(IMetaDataImport2 *pMetaDataImport, mdToken tkType);
-inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, const ClassID *typeArgs, ULONG typeArgsCount, PCCOR_SIGNATURE &pSig);
+inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, const ClassID *typeArgs, ULONG typeArgsCount, PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end);
 
 inline std::string GetTypeNameFromTypeToken(IMetaDataImport2 *pMetaDataImport, mdToken tkType)
 {
@@ -189,8 +189,15 @@ inline std::string GetTypeNameFromTypeToken(IMetaDataImport2 *pMetaDataImport, m
     ULONG cbSpecSig = 0;
     if (SUCCEEDED(pMetaDataImport->GetTypeSpecFromToken(tkType, &pSpecSig, &cbSpecSig)) && pSpecSig != nullptr)
     {
+      // A TypeSpec can name itself through CLASS; real metadata never nests this deep.
+      static thread_local int t_typeSpecDepth = 0;
+      if (t_typeSpecDepth >= 16)
+        return "";
+      t_typeSpecDepth++;
       PCCOR_SIGNATURE p = pSpecSig;
-      return ParseSigType(nullptr, pMetaDataImport, 0, nullptr, 0, p);
+      std::string name = ParseSigType(nullptr, pMetaDataImport, 0, nullptr, 0, p, pSpecSig + cbSpecSig);
+      t_typeSpecDepth--;
+      return name;
     }
   }
 
@@ -253,9 +260,56 @@ inline std::string GetTypeNameFromClassID(ICorProfilerInfo15 *pInfo, IMetaDataIm
   return "";
 }
 
-inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, const ClassID *typeArgs, ULONG typeArgsCount, PCCOR_SIGNATURE &pSig)
+// Bounded forms of CorSigUncompress*: false, without reading at or past end, when the blob is
+// exhausted or the value is badly encoded. The cursor only moves on success.
+inline bool SigReadByte(PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end, ULONG &value)
 {
-  CorElementType et = (CorElementType)*pSig++;
+  if (pSig == nullptr || pSig >= end)
+    return false;
+  value = *pSig++;
+  return true;
+}
+
+inline bool SigReadData(PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end, ULONG &value)
+{
+  ULONG length = 0;
+  if (pSig == nullptr || pSig >= end || FAILED(CorSigUncompressData(pSig, static_cast<DWORD>(end - pSig), &value, &length)))
+    return false;
+  pSig += length;
+  return true;
+}
+
+inline bool SigReadToken(PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end, mdToken &token)
+{
+  DWORD length = 0;
+  if (pSig == nullptr || pSig >= end || FAILED(CorSigUncompressToken(pSig, static_cast<DWORD>(end - pSig), &token, &length)))
+    return false;
+  pSig += length;
+  return true;
+}
+
+inline bool SigReadSignedInt(PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end, int &value)
+{
+  DWORD length = 0;
+  if (pSig == nullptr || pSig >= end || FAILED(CorSigUncompressSignedInt(pSig, static_cast<DWORD>(end - pSig), &value, &length)))
+    return false;
+  pSig += length;
+  return true;
+}
+
+// Renders one type and moves pSig past it. A blob that ends, or is badly encoded, before the type
+// does sets pSig to nullptr and returns "", and so does every later call with that cursor.
+inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, const ClassID *typeArgs, ULONG typeArgsCount, PCCOR_SIGNATURE &pSig, PCCOR_SIGNATURE end)
+{
+  auto malformed = [&pSig]() {
+    pSig = nullptr;
+    return std::string();
+  };
+
+  ULONG elementType = 0;
+  if (!SigReadByte(pSig, end, elementType))
+    return malformed();
+  CorElementType et = (CorElementType)elementType;
   auto prim = ElementTypeName(et);
   if (!prim.empty())
     return prim;
@@ -266,32 +320,38 @@ inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMe
   case ELEMENT_TYPE_VALUETYPE:
   {
     mdToken tk = 0;
-    pSig += CorSigUncompressToken(pSig, &tk);
+    if (!SigReadToken(pSig, end, tk))
+      return malformed();
     return GetTypeNameFromTypeToken(pMetaDataImport, tk);
   }
   case ELEMENT_TYPE_SZARRAY:
   {
-    auto elem = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+    auto elem = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
+    if (pSig == nullptr)
+      return "";
     return elem + "[]";
   }
   case ELEMENT_TYPE_ARRAY:
   {
-    auto elem = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+    auto elem = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
     ULONG rank = 0;
-    pSig += CorSigUncompressData(pSig, &rank);
     ULONG numSizes = 0;
-    pSig += CorSigUncompressData(pSig, &numSizes);
+    if (!SigReadData(pSig, end, rank) || !SigReadData(pSig, end, numSizes))
+      return malformed();
     for (ULONG i = 0; i < numSizes; i++)
     {
       ULONG tmp = 0;
-      pSig += CorSigUncompressData(pSig, &tmp);
+      if (!SigReadData(pSig, end, tmp))
+        return malformed();
     }
     ULONG numLoBounds = 0;
-    pSig += CorSigUncompressData(pSig, &numLoBounds);
+    if (!SigReadData(pSig, end, numLoBounds))
+      return malformed();
     for (ULONG i = 0; i < numLoBounds; i++)
     {
       int tmp = 0;
-      pSig += CorSigUncompressSignedInt(pSig, &tmp);
+      if (!SigReadSignedInt(pSig, end, tmp))
+        return malformed();
     }
     std::string dims = "[";
     for (ULONG i = 1; i < rank; i++)
@@ -301,28 +361,34 @@ inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMe
   }
   case ELEMENT_TYPE_BYREF:
   {
-    auto inner = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+    auto inner = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
+    if (pSig == nullptr)
+      return "";
     return inner + "&";
   }
   case ELEMENT_TYPE_PTR:
   {
-    auto inner = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+    auto inner = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
+    if (pSig == nullptr)
+      return "";
     return inner + "*";
   }
   case ELEMENT_TYPE_GENERICINST:
   {
-    CorElementType kind = (CorElementType)*pSig++;
+    ULONG kind = 0;
     mdToken tk = 0;
-    pSig += CorSigUncompressToken(pSig, &tk);
     ULONG n = 0;
-    pSig += CorSigUncompressData(pSig, &n);
+    if (!SigReadByte(pSig, end, kind) || !SigReadToken(pSig, end, tk) || !SigReadData(pSig, end, n))
+      return malformed();
     std::string name = GetTypeNameFromTypeToken(pMetaDataImport, tk);
     name += "<";
     for (ULONG i = 0; i < n; i++)
     {
       if (i)
         name += ", ";
-      name += ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+      name += ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
+      if (pSig == nullptr)
+        return "";
     }
     name += ">";
     return name;
@@ -331,7 +397,8 @@ inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMe
   case ELEMENT_TYPE_MVAR:
   {
     ULONG idx = 0;
-    pSig += CorSigUncompressData(pSig, &idx);
+    if (!SigReadData(pSig, end, idx))
+      return malformed();
     if (typeArgs != nullptr && idx < typeArgsCount && pInfo != nullptr)
     {
       ClassID cid = typeArgs[idx];
@@ -344,36 +411,74 @@ inline std::string ParseSigType(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMe
   case ELEMENT_TYPE_TYPEDBYREF:
     return "typedref";
   case ELEMENT_TYPE_FNPTR:
+  {
+    // The pointee is a whole method signature; walk it so the caller's cursor stays in step.
+    ULONG callConv = 0;
+    if (!SigReadData(pSig, end, callConv))
+      return malformed();
+    if (callConv & IMAGE_CEE_CS_CALLCONV_GENERIC)
+    {
+      ULONG genCount = 0;
+      if (!SigReadData(pSig, end, genCount))
+        return malformed();
+    }
+    ULONG paramCount = 0;
+    if (!SigReadData(pSig, end, paramCount))
+      return malformed();
+    for (ULONG i = 0; i <= paramCount && pSig != nullptr; i++)
+      ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
+    if (pSig == nullptr)
+      return "";
     return "fnptr";
+  }
   case ELEMENT_TYPE_PINNED:
-    return ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig);
+    return ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSig, end);
   default:
     return "";
   }
 }
 
-inline std::string GetMethodSignature(ICorProfilerInfo15 *pInfo, FunctionID functionId, COR_PRF_FRAME_INFO frameInfo, const std::string &declaringTypeName)
+// The parts of a method signature that depend only on (ModuleID, mdMethodDef). Every
+// instantiation of a method shares one of these; only VAR/MVAR resolution differs per FunctionID.
+struct MethodTokenInfo
 {
-  if (pInfo == nullptr)
-    return "";
-  ClassID classId = 0;
-  ModuleID moduleId = 0;
-  mdToken tkMethod = 0;
-
-  ULONG32 typeArgsCount = 0;
-  pInfo->GetFunctionInfo2(functionId, frameInfo, &classId, &moduleId, &tkMethod, 0, &typeArgsCount, NULL);
+  std::string name;
+  std::vector<std::string> paramNames;
+  // Signature blob from the return type on.
+  std::vector<COR_SIGNATURE> signature;
+  ULONG paramCount = 0;
+  // Return type and parameter list rendered without type arguments, which is what a FunctionID
+  // that reports none gets.
+  std::string returnType;
+  std::string parameters;
+};
+
+// Renders the return type and "(type name, ...)" from a cached signature blob, walking no
+// further than its end. False when the blob ends before the last parameter does.
+inline bool FormatMethodTypes(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, const MethodTokenInfo &token, const ClassID *typeArgs, ULONG typeArgsCount, std::string &returnType, std::string &parameters)
+{
+  PCCOR_SIGNATURE pSigWalk = token.signature.data();
+  PCCOR_SIGNATURE pSigEnd = pSigWalk + token.signature.size();
+  returnType = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSigWalk, pSigEnd);
 
-  std::vector<ClassID> typeArgs;
-  if (typeArgsCount)
+  parameters = "(";
+  for (ULONG i = 0; i < token.paramCount; i++)
   {
-    typeArgs.resize(typeArgsCount);
-    pInfo->GetFunctionInfo2(functionId, frameInfo, &classId, &moduleId, &tkMethod, typeArgsCount, &typeArgsCount, typeArgs.data());
+    if (i)
+      parameters += ", ";
+    parameters += ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs, typeArgsCount, pSigWalk, pSigEnd);
+    if (!token.paramNames[i].empty())
+    {
+      parameters += " ";
+      parameters += token.paramNames[i];
+    }
   }
+  parameters += ")";
+  return pSigWalk != nullptr;
+}
 
-  IMetaDataImport2 *pMetaDataImport = nullptr;
-  if (FAILED(pInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport2, reinterpret_cast<IUnknown **>(&pMetaDataImport))) || pMetaDataImport == nullptr)
-    return "";
-
+inline bool ReadMethodTokenInfo(ICorProfilerInfo15 *pInfo, IMetaDataImport2 *pMetaDataImport, ModuleID moduleId, mdMethodDef tkMethod, MethodTokenInfo &out)
+{
   const ULONG nameBufLen = 512;
   WCHAR wszMethodName[nameBufLen];
   wszMethodName[0] = static_cast<WCHAR>(0);
@@ -381,30 +486,29 @@ inline std::string GetMethodSignature(ICorProfilerInfo15 *pInfo, FunctionID func
   ULONG cbSig = 0;
   mdTypeDef mdClass = 0;
 
-  auto hr = pMetaDataImport->GetMethodProps((mdMethodDef)tkMethod, &mdClass, wszMethodName, nameBufLen, nullptr, nullptr, &pSig, &cbSig, nullptr, nullptr);
+  auto hr = pMetaDataImport->GetMethodProps(tkMethod, &mdClass, wszMethodName, nameBufLen, nullptr, nullptr, &pSig, &cbSig, nullptr, nullptr);
   if (FAILED(hr) || pSig == nullptr)
-  {
-    pMetaDataImport->Release();
-    return "";
-  }
+    return false;
 
+  PCCOR_SIGNATURE pSigEnd = pSig + cbSig;
   ULONG callConv = 0;
-  pSig += CorSigUncompressData(pSig, &callConv);
-
-  if (callConv & IMAGE_CEE_CS_CALLCONV_GENERIC)
-  {
-    ULONG genCount = 0;
-    pSig += CorSigUncompressData(pSig, &genCount);
-  }
-
+  ULONG genCount = 0;
   ULONG paramCount = 0;
-  pSig += CorSigUncompressData(pSig, &paramCount);
-
-  std::vector<std::string> paramNames(paramCount);
+  if (!SigReadData(pSig, pSigEnd, callConv) ||
+      ((callConv & IMAGE_CEE_CS_CALLCONV_GENERIC) && !SigReadData(pSig, pSigEnd, genCount)) ||
+      !SigReadData(pSig, pSigEnd, paramCount))
+    return false;
+  // Every parameter takes at least a byte, so a larger count can only come from a bad blob.
+  if (paramCount > static_cast<ULONG>(pSigEnd - pSig))
+    return false;
+
+  out.name = WStrToUtf8(wszMethodName);
+  out.paramCount = paramCount;
+  out.paramNames.assign(paramCount, std::string());
   HCORENUM hEnum = nullptr;
   mdParamDef paramDefs[32];
   ULONG fetched = 0;
-  while (SUCCEEDED(pMetaDataImport->EnumParams(&hEnum, (mdMethodDef)tkMethod, paramDefs, ARRAY_LEN(paramDefs), &fetched)) && fetched)
+  while (SUCCEEDED(pMetaDataImport->EnumParams(&hEnum, tkMethod, paramDefs, ARRAY_LEN(paramDefs), &fetched)) && fetched)
   {
     for (ULONG i = 0; i < fetched; i++)
     {
@@ -412,36 +516,68 @@ inline std::string GetMethodSignature(ICorProfilerInfo15 *pInfo, FunctionID func
       WCHAR wszParam[256];
       wszParam[0] = static_cast<WCHAR>(0);
       if (SUCCEEDED(pMetaDataImport->GetParamProps(paramDefs[i], nullptr, &seq, wszParam, 256, nullptr, nullptr, nullptr, nullptr, nullptr)) && seq >= 1 && seq <= paramCount)
-        paramNames[seq - 1] = WStrToUtf8(wszParam);
+        out.paramNames[seq - 1] = WStrToUtf8(wszParam);
     }
   }
   if (hEnum)
     pMetaDataImport->CloseEnum(hEnum);
 
-  PCCOR_SIGNATURE pSigWalk = pSig;
-  auto retType = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs.empty() ? nullptr : typeArgs.data(), typeArgsCount, pSigWalk);
+  out.signature.assign(pSig, pSigEnd);
+  return FormatMethodTypes(pInfo, pMetaDataImport, moduleId, out, nullptr, 0, out.returnType, out.parameters);
+}
 
-  std::string sig = retType;
+inline std::string ComposeMethodSignature(const std::string &returnType, const std::string &declaringTypeName, const std::string &name, const std::string &parameters)
+{
+  std::string sig;
+  sig.reserve(returnType.size() + declaringTypeName.size() + name.size() + parameters.size() + 2);
+  sig += returnType;
   sig += " ";
   sig += declaringTypeName;
   sig += ".";
-  sig += WStrToUtf8(wszMethodName);
-  sig += "(";
+  sig += name;
+  sig += parameters;
+  return sig;
+}
+
+// Uncached; StackManager keeps MethodTokenInfo per (ModuleID, mdMethodDef) and only re-renders
+// the types for instantiations that report type arguments.
+inline std::string GetMethodSignature(ICorProfilerInfo15 *pInfo, FunctionID functionId, COR_PRF_FRAME_INFO frameInfo, const std::string &declaringTypeName)
+{
+  if (pInfo == nullptr)
+    return "";
+  ClassID classId = 0;
+  ModuleID moduleId = 0;
+  mdToken tkMethod = 0;
+
+  ULONG32 typeArgsCount = 0;
+  pInfo->GetFunctionInfo2(functionId, frameInfo, &classId, &moduleId, &tkMethod, 0, &typeArgsCount, NULL);
 
-  for (ULONG i = 0; i < paramCount; i++)
+  std::vector<ClassID> typeArgs;
+  if (typeArgsCount)
   {
-    if (i)
-      sig += ", ";
-    auto t = ParseSigType(pInfo, pMetaDataImport, moduleId, typeArgs.empty() ? nullptr : typeArgs.data(), typeArgsCount, pSigWalk);
-    sig += t;
-    if (!paramNames[i].empty())
-    {
-      sig += " ";
-      sig += paramNames[i];
-    }
+    typeArgs.resize(typeArgsCount);
+    pInfo->GetFunctionInfo2(functionId, frameInfo, &classId, &moduleId, &tkMethod, typeArgsCount, &typeArgsCount, typeArgs.data());
+  }
+
+  IMetaDataImport2 *pMetaDataImport = nullptr;
+  if (FAILED(pInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport2, reinterpret_cast<IUnknown **>(&pMetaDataImport))) || pMetaDataImport == nullptr)
+    return "";
+
+  MethodTokenInfo token;
+  if (!ReadMethodTokenInfo(pInfo, pMetaDataImport, moduleId, (mdMethodDef)tkMethod, token))
+  {
+    pMetaDataImport->Release();
+    return "";
+  }
+
+  std::string returnType = token.returnType;
+  std::string parameters = token.parameters;
+  if (typeArgsCount && !FormatMethodTypes(pInfo, pMetaDataImport, moduleId, token, typeArgs.data(), typeArgsCount, returnType, parameters))
+  {
+    returnType = token.returnType;
+    parameters = token.parameters;
   }
-  sig += ")";
 
   pMetaDataImport->Release();
-  return sig;
-}
\ No newline at end of file
+  return ComposeMethodSignature(returnType, declaringTypeName, token.name, parameters);
+}
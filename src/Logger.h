@@ -1,17 +1,268 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
-inline void LOG(const char *fmt, ...)
+// LOG is called from hook threads (desync warnings in FunctionLeave run under the per-thread
+// stack mutex), so it must never touch stdout itself: a blocked console pipe would stall managed
+// code. Each call formats into a fixed-size record on the caller's stack and pushes it into a
+// bounded MPSC ring; a background thread writes records to stdout, or to SW2TRACER_LOG_FILE
+// when set. A full ring drops the record and counts it, and the writer reports the count.
+//
+// The writer is started by Initialize, before any hook can run. Until then (and when the thread
+// could not be created) records are written inline; after Stop they are dropped and counted.
+class AsyncLogger
 {
-  std::fputs("[SW2 TRACER] ", stdout);
+public:
+  static constexpr size_t kRecordBytes = 256;
+  static constexpr size_t kCapacity = 1024;
+
+  AsyncLogger()
+  {
+    for (size_t i = 0; i < kCapacity; i++)
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    const char *path = std::getenv("SW2TRACER_LOG_FILE");
+    if (path != nullptr && path[0] != '\0')
+      m_file = std::fopen(path, "a");
+  }
+
+  void Write(const char *fmt, va_list args)
+  {
+    char text[kRecordBytes];
+    size_t length = Format(text, fmt, args);
+
+    // Registered before the state is read, so Stop cannot miss a record pushed after it: it
+    // waits for every writer that saw the logger running.
+    m_activeWriters.fetch_add(1, std::memory_order_seq_cst);
+    const State state = m_state.load(std::memory_order_seq_cst);
+    if (state != State::Running)
+    {
+      m_activeWriters.fetch_sub(1, std::memory_order_release);
+      if (state == State::Stopped)
+      {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      std::lock_guard<std::mutex> lock(m_inlineMutex);
+      std::fwrite(text, 1, length, Output());
+      std::fflush(Output());
+      return;
+    }
+
+    const bool pushed = TryPush(text, length);
+    if (!pushed)
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+    m_activeWriters.fetch_sub(1, std::memory_order_release);
+    if (!pushed)
+      return;
+
+    // Pairs with the fence in Run: either the writer sees this record before it sleeps, or we
+    // see it idle and wake it. A busy writer is not notified.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerIdle.load(std::memory_order_acquire))
+      Wake();
+  }
+
+  // Starts the writer thread. Called from Initialize; later calls do nothing.
+  void Start()
+  {
+    State expected = State::Inline;
+    if (!m_state.compare_exchange_strong(expected, State::Starting, std::memory_order_acq_rel))
+      return;
+
+    try
+    {
+      m_writer = std::thread([this]() { Run(); });
+      m_state.store(State::Running, std::memory_order_seq_cst);
+    }
+    catch (const std::system_error &)
+    {
+      m_state.store(State::Inline, std::memory_order_seq_cst);
+    }
+  }
+
+  // Drains what is queued and joins the writer; records logged from here on are dropped.
+  // Called from Shutdown.
+  void Stop()
+  {
+    const State previous = m_state.exchange(State::Stopped, std::memory_order_seq_cst);
+    if (previous != State::Running)
+      return;
+    while (m_activeWriters.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+    m_drainAndExit.store(true, std::memory_order_release);
+    Wake();
+    if (m_writer.joinable())
+      m_writer.join();
+  }
+
+  uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence{0};
+    uint32_t length = 0;
+    char text[kRecordBytes];
+  };
+
+  static size_t Format(char (&text)[kRecordBytes], const char *fmt, va_list args)
+  {
+    static const char kPrefix[] = "[SW2 TRACER] ";
+    const size_t prefixLength = sizeof(kPrefix) - 1;
+    std::memcpy(text, kPrefix, prefixLength);
+
+    // Leave room for the newline; overlong messages are truncated.
+    int n = std::vsnprintf(text + prefixLength, kRecordBytes - prefixLength - 1, fmt, args);
+    size_t length = prefixLength;
+    if (n > 0)
+      length += (std::min)(static_cast<size_t>(n), kRecordBytes - prefixLength - 2);
+    text[length++] = '\n';
+    return length;
+  }
+
+  // Vyukov's bounded queue with a single consumer: a slot is free for ticket t when its sequence
+  // equals t, and holds a record for the reader when it equals t + 1.
+  bool TryPush(const char *text, size_t length)
+  {
+    uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    for (;;)
+    {
+      slot = &m_slots[pos & (kCapacity - 1)];
+      uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+      if (diff == 0)
+      {
+        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    std::memcpy(slot->text, text, length);
+    slot->length = static_cast<uint32_t>(length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
 
+  // Writer thread only.
+  bool TryPop(FILE *out)
+  {
+    Slot &slot = m_slots[m_dequeuePos & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1)
+      return false;
+    std::fwrite(slot.text, 1, slot.length, out);
+    slot.sequence.store(m_dequeuePos + kCapacity, std::memory_order_release);
+    m_dequeuePos++;
+    return true;
+  }
+
+  enum class State : uint32_t
+  {
+    Inline,
+    Starting,
+    Running,
+    Stopped,
+  };
+
+  FILE *Output()
+  {
+    return m_file != nullptr ? m_file : stdout;
+  }
+
+  void Wake()
+  {
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_one();
+  }
+
+  // Writer thread only: whether the next slot holds a record.
+  bool HasRecord() const
+  {
+    return m_slots[m_dequeuePos & (kCapacity - 1)].sequence.load(std::memory_order_acquire) == m_dequeuePos + 1;
+  }
+
+  void Run()
+  {
+    FILE *out = Output();
+    uint64_t reportedDrops = 0;
+    for (;;)
+    {
+      bool wrote = false;
+      while (TryPop(out))
+        wrote = true;
+
+      uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+      if (dropped != reportedDrops)
+      {
+        std::fprintf(out, "[SW2 TRACER] WARNING: %llu log records dropped (queue full)\n", static_cast<unsigned long long>(dropped - reportedDrops));
+        reportedDrops = dropped;
+        wrote = true;
+      }
+      if (wrote)
+        std::fflush(out);
+
+      if (m_drainAndExit.load(std::memory_order_acquire))
+      {
+        // Stop waited for every producer that saw the logger running, so this drains all.
+        while (TryPop(out))
+          wrote = true;
+        std::fflush(out);
+        return;
+      }
+
+      const uint32_t observed = m_wake.load(std::memory_order_acquire);
+      m_writerIdle.store(true, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!HasRecord() && !m_drainAndExit.load(std::memory_order_acquire))
+        m_wake.wait(observed, std::memory_order_acquire);
+      m_writerIdle.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  std::unique_ptr<Slot[]> m_slots = std::make_unique<Slot[]>(kCapacity);
+  std::atomic<uint64_t> m_enqueuePos{0};
+  uint64_t m_dequeuePos = 0;
+  std::atomic<uint64_t> m_dropped{0};
+  std::atomic<uint32_t> m_wake{0};
+  std::atomic<State> m_state{State::Inline};
+  std::atomic<uint32_t> m_activeWriters{0};
+  std::atomic<bool> m_writerIdle{false};
+  std::atomic<bool> m_drainAndExit{false};
+  std::thread m_writer;
+  std::mutex m_inlineMutex;
+  FILE *m_file = nullptr;
+};
+
+// Never destroyed: hook threads may still log while the runtime tears the process down.
+inline AsyncLogger &GlobalLogger()
+{
+  static AsyncLogger *logger = new AsyncLogger();
+  return *logger;
+}
+
+inline void LOG(const char *fmt, ...)
+{
   va_list args;
   va_start(args, fmt);
-  std::vfprintf(stdout, fmt, args);
+  GlobalLogger().Write(fmt, args);
   va_end(args);
-
-  std::fputc('\n', stdout);
-  std::fflush(stdout);
-}
\ No newline at end of file
+}
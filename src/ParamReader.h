@@ -45,13 +45,9 @@ static inline std::string HexPtr(UINT_PTR p)
   return oss.str();
 }
 
-static inline std::string TryGetObjectTypeName(ICorProfilerInfo15* pInfo, ObjectID objId)
+static inline std::string TryGetClassTypeName(ICorProfilerInfo15* pInfo, ClassID classId)
 {
-  if (pInfo == nullptr || objId == 0)
-    return "";
-
-  ClassID classId = 0;
-  if (FAILED(pInfo->GetClassFromObject(objId, &classId)) || classId == 0)
+  if (pInfo == nullptr || classId == 0)
     return "";
 
   ModuleID moduleId = 0;
@@ -65,6 +61,17 @@ static inline std::string TryGetObjectTypeName(ICorProfilerInfo15* pInfo, Object
   return WStrToUtf8(name);
 }
 
+static inline std::string TryGetObjectTypeName(ICorProfilerInfo15* pInfo, ObjectID objId)
+{
+  if (pInfo == nullptr || objId == 0)
+    return "";
+
+  ClassID classId = 0;
+  if (FAILED(pInfo->GetClassFromObject(objId, &classId)) || classId == 0)
+    return "";
+  return TryGetClassTypeName(pInfo, classId);
+}
+
 static inline size_t ElementSizeBytes(ICorProfilerInfo15* pInfo, CorElementType et, ClassID valueTypeClassId)
 {
   switch (et)
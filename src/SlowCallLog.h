@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cor.h"
+#include "corprof.h"
+
+// A call that took longer than its slow-call threshold, with the shadow stack it returned to.
+// frames[0] is the slow method, followed by its callers; depth may exceed kMaxFrames.
+struct SlowCallRecord
+{
+  static constexpr uint32_t kMaxFrames = 32;
+
+  ThreadID threadId;
+  uint64_t leaveTsc;
+  uint64_t durationCycles;
+  uint32_t depth;
+  uint32_t frameCount;
+  FunctionID frames[kMaxFrames];
+};
+
+// Bounded log shared by all threads. A writer claims a slot with one fetch_add and publishes it
+// through the slot's sequence (odd while the record is being copied), so FunctionLeave never
+// waits on a lock or on other writers. Readers skip slots that are mid-write or were lapped
+// while they copied them.
+class SlowCallLog
+{
+public:
+  explicit SlowCallLog(uint32_t capacity)
+  {
+    uint32_t size = 16;
+    while (size < capacity && size < (1u << 20))
+      size <<= 1;
+    m_mask = size - 1;
+    m_slots = std::make_unique<Slot[]>(size);
+  }
+
+  void Push(const SlowCallRecord &record)
+  {
+    const uint64_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = m_slots[ticket & m_mask];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+  }
+
+  // Oldest first, at most maxRecords of the most recent records.
+  std::vector<SlowCallRecord> Snapshot(size_t maxRecords) const
+  {
+    const uint64_t capacity = static_cast<uint64_t>(m_mask) + 1;
+    const uint64_t next = m_next.load(std::memory_order_acquire);
+    const uint64_t count = std::min<uint64_t>({next, capacity, static_cast<uint64_t>(maxRecords)});
+
+    std::vector<SlowCallRecord> out;
+    out.reserve(count);
+    for (uint64_t ticket = next - count; ticket < next; ticket++)
+    {
+      const Slot &slot = m_slots[ticket & m_mask];
+      const uint64_t published = 2 * ticket + 2;
+      if (slot.sequence.load(std::memory_order_acquire) != published)
+        continue;
+      SlowCallRecord copy = slot.record;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == published)
+        out.push_back(copy);
+    }
+    return out;
+  }
+
+  uint64_t Total() const { return m_next.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence{0};
+    SlowCallRecord record{};
+  };
+
+  std::unique_ptr<Slot[]> m_slots;
+  uint32_t m_mask = 0;
+  std::atomic<uint64_t> m_next{0};
+};
@@ -11,9 +11,13 @@
 #include <cstdint>
 #include <utility>
 #include <vector>
+#include <unordered_set>
 #include <shared_mutex>
+#include <filesystem>
 #include <fstream>
 #include <algorithm>
+#include <bit>
+#include <cstring>
 #include "Helper.h"
 #include "ParamReader.h"
 
@@ -63,18 +67,18 @@ namespace
     auto hr = pMetaDataImport->GetMethodProps(
         tkMethod, &type, name, ARRAY_LEN(name) - 1, &size, &attributes, &pSig, &blobSize, &codeRva, &flags);
 
+    PCCOR_SIGNATURE pSigEnd = pSig + blobSize;
     ULONG callConv = 0;
-    pSig += CorSigUncompressData(pSig, &callConv);
-    out.hasThis = ((callConv & IMAGE_CEE_CS_CALLCONV_HASTHIS) != 0);
-
-    if (callConv & IMAGE_CEE_CS_CALLCONV_GENERIC)
+    ULONG genCount = 0;
+    ULONG paramCount = 0;
+    if (FAILED(hr) || pSig == nullptr || !SigReadData(pSig, pSigEnd, callConv) ||
+        ((callConv & IMAGE_CEE_CS_CALLCONV_GENERIC) && !SigReadData(pSig, pSigEnd, genCount)) ||
+        !SigReadData(pSig, pSigEnd, paramCount) || paramCount > static_cast<ULONG>(pSigEnd - pSig))
     {
-      ULONG genCount = 0;
-      pSig += CorSigUncompressData(pSig, &genCount);
+      pMetaDataImport->Release();
+      return out;
     }
-
-    ULONG paramCount = 0;
-    pSig += CorSigUncompressData(pSig, &paramCount);
+    out.hasThis = ((callConv & IMAGE_CEE_CS_CALLCONV_HASTHIS) != 0);
 
     std::vector<std::string> paramNames(paramCount);
     HCORENUM hEnum = nullptr;
@@ -95,14 +99,14 @@ namespace
       pMetaDataImport->CloseEnum(hEnum);
 
     PCCOR_SIGNATURE pWalk = pSig;
-    (void)ParseSigType(pInfo, pMetaDataImport, moduleId, nullptr, 0, pWalk);
+    (void)ParseSigType(pInfo, pMetaDataImport, moduleId, nullptr, 0, pWalk, pSigEnd);
 
     out.parameters.reserve(paramCount);
-    for (ULONG i = 0; i < paramCount; i++)
+    for (ULONG i = 0; i < paramCount && pWalk != nullptr && pWalk < pSigEnd; i++)
     {
       ParamMeta pm;
       pm.elementType = (CorElementType)*pWalk;
-      pm.typeName = ParseSigType(pInfo, pMetaDataImport, moduleId, nullptr, 0, pWalk);
+      pm.typeName = ParseSigType(pInfo, pMetaDataImport, moduleId, nullptr, 0, pWalk, pSigEnd);
       pm.name = std::move(paramNames[i]);
       out.parameters.push_back(std::move(pm));
     }
@@ -111,10 +115,157 @@ namespace
     return out;
   }
 
+  // The element type FunctionLeave decodes for this method's return value, or ELEMENT_TYPE_END
+  // when there is nothing to decode: void, value types, byrefs and generic parameters.
+  static CorElementType GetReturnElementType(const MethodTokenInfo &token)
+  {
+    PCCOR_SIGNATURE pSig = token.signature.data();
+    PCCOR_SIGNATURE pEnd = pSig + token.signature.size();
+    while (pSig < pEnd && (*pSig == ELEMENT_TYPE_CMOD_REQD || *pSig == ELEMENT_TYPE_CMOD_OPT))
+    {
+      mdToken modifier = 0;
+      pSig++;
+      if (!SigReadToken(pSig, pEnd, modifier))
+        return ELEMENT_TYPE_END;
+    }
+    if (pSig >= pEnd)
+      return ELEMENT_TYPE_END;
+
+    auto et = static_cast<CorElementType>(*pSig);
+    switch (et)
+    {
+    case ELEMENT_TYPE_GENERICINST:
+      return pSig + 1 < pEnd && pSig[1] == ELEMENT_TYPE_CLASS ? ELEMENT_TYPE_CLASS : ELEMENT_TYPE_END;
+    case ELEMENT_TYPE_BOOLEAN:
+    case ELEMENT_TYPE_CHAR:
+    case ELEMENT_TYPE_I1:
+    case ELEMENT_TYPE_U1:
+    case ELEMENT_TYPE_I2:
+    case ELEMENT_TYPE_U2:
+    case ELEMENT_TYPE_I4:
+    case ELEMENT_TYPE_U4:
+    case ELEMENT_TYPE_I8:
+    case ELEMENT_TYPE_U8:
+    case ELEMENT_TYPE_R4:
+    case ELEMENT_TYPE_R8:
+    case ELEMENT_TYPE_I:
+    case ELEMENT_TYPE_U:
+    case ELEMENT_TYPE_PTR:
+    case ELEMENT_TYPE_STRING:
+    case ELEMENT_TYPE_CLASS:
+    case ELEMENT_TYPE_OBJECT:
+    case ELEMENT_TYPE_SZARRAY:
+    case ELEMENT_TYPE_ARRAY:
+      return et;
+    default:
+      return ELEMENT_TYPE_END;
+    }
+  }
+
+  // Stands in for the FunctionInfo of frames whose module was unloaded while they were on a stack.
+  const FunctionInfo kUnloadedFunctionInfo{0, 0, "<unloaded>", "<unloaded>", "", "<unloaded method>", ELEMENT_TYPE_END, UINT64_MAX, "<unloaded>", "", "<unloaded method>"};
+
+  // filters is a comma-separated list of substrings; an empty list matches everything.
+  static bool MatchesAnyFilter(const std::string &text, const std::string &filters)
+  {
+    if (filters.empty())
+      return true;
+    size_t start = 0;
+    while (start <= filters.size())
+    {
+      size_t end = filters.find(',', start);
+      if (end == std::string::npos)
+        end = filters.size();
+      if (end > start && text.find(filters.data() + start, 0, end - start) != std::string::npos)
+        return true;
+      start = end + 1;
+    }
+    return false;
+  }
+
   static std::string DefaultArgName(ULONG idx)
   {
     return "arg" + std::to_string(idx);
   }
+
+  static std::string JsonEscape(const std::string &in)
+  {
+    std::string out;
+    out.reserve(in.size());
+    for (char c : in)
+    {
+      switch (c)
+      {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+          out += ' ';
+        else
+          out += c;
+        break;
+      }
+    }
+    return out;
+  }
+
+  static const char *FlightEventKindName(FlightEventKind kind)
+  {
+    switch (kind)
+    {
+    case FlightEventKind::Enter:
+      return "enter";
+    case FlightEventKind::Leave:
+      return "leave";
+    case FlightEventKind::Tailcall:
+      return "tailcall";
+    case FlightEventKind::TransitionCall:
+      return "native->managed call";
+    case FlightEventKind::TransitionReturn:
+      return "native->managed return";
+    case FlightEventKind::Unwind:
+      return "unwind";
+    default:
+      return "?";
+    }
+  }
+
+  constexpr uint32_t kHookSampleInterval = 16;
+  thread_local uint32_t t_hookSampleCounter = 0;
+
+  inline void BumpCounter(std::atomic<uint64_t> &counter, uint64_t delta = 1)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
+
+  // Times one in kHookSampleInterval hook calls; the histogram is attached once the thread state is known.
+  struct HookLatencySample
+  {
+    uint64_t start = 0;
+    std::array<std::atomic<uint64_t>, kHookHistogramBuckets> *histogram = nullptr;
+
+    HookLatencySample()
+    {
+      if ((++t_hookSampleCounter % kHookSampleInterval) == 0)
+        start = ReadTsc();
+    }
+
+    ~HookLatencySample()
+    {
+      if (start == 0 || histogram == nullptr)
+        return;
+      uint64_t cycles = ReadTsc() - start;
+      size_t bucket = std::min<size_t>(std::bit_width(cycles), kHookHistogramBuckets - 1);
+      BumpCounter((*histogram)[bucket]);
+    }
+  };
 }
 
 size_t StackManager::BucketIndex(ThreadID tid) const
@@ -140,14 +291,19 @@ StackManager::ThreadStackState &StackManager::GetOrCreateThreadState(ThreadID ti
       return *it->second;
 
     auto st = std::make_unique<ThreadStackState>();
+    st->threadId = tid;
     st->EnsureInit();
+    if (m_config.flightRecorderEvents != 0)
+      st->flight = std::make_unique<FlightRecorder>(m_config.flightRecorderEvents);
+    if (m_config.captureReturns && m_config.returnRecords != 0)
+      st->returns = std::make_unique<ReturnRecorder>(m_config.returnRecords);
     auto &ref = *st;
     bucket.stacks.emplace(tid, std::move(st));
     return ref;
   }
 }
 
-const FunctionInfo *StackManager::GetOrBuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo)
+const FunctionInfo *StackManager::GetOrBuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo, uint64_t *buildCycles)
 {
   {
     std::shared_lock lock(m_functionInfosMutex);
@@ -158,7 +314,10 @@ const FunctionInfo *StackManager::GetOrBuildFunctionInfo(FunctionID id, COR_PRF_
     }
   }
 
+  const uint64_t buildStart = ReadTsc();
   FunctionInfo built = BuildFunctionInfo(id, frameInfo);
+  if (buildCycles != nullptr)
+    *buildCycles = ReadTsc() - buildStart;
 
   {
     std::unique_lock lock(m_functionInfosMutex);
@@ -167,6 +326,9 @@ const FunctionInfo *StackManager::GetOrBuildFunctionInfo(FunctionID id, COR_PRF_
     {
       return it->second.get();
     }
+    // Its module was evicted while this was being built; caching it now would outlive the unload.
+    if (IsModuleUnloading(built.moduleId))
+      return &kUnloadedFunctionInfo;
     auto ptr = std::make_unique<FunctionInfo>(std::move(built));
     const FunctionInfo *raw = ptr.get();
     m_functionInfos.emplace(id, std::move(ptr));
@@ -174,6 +336,13 @@ const FunctionInfo *StackManager::GetOrBuildFunctionInfo(FunctionID id, COR_PRF_
   }
 }
 
+const FunctionInfo *StackManager::FindFunctionInfo(FunctionID id) const
+{
+  std::shared_lock lock(m_functionInfosMutex);
+  auto it = m_functionInfos.find(id);
+  return it != m_functionInfos.end() ? it->second.get() : nullptr;
+}
+
 void StackManager::GetArgumentInfo(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, std::vector<std::string> &argumentInfo)
 {
   COR_PRF_FRAME_INFO frameInfo = NULL;
@@ -276,32 +445,112 @@ void StackManager::GetArgumentInfo(FunctionIDOrClientID id, COR_PRF_ELT_INFO elt
   }
 }
 
-void StackManager::FunctionEnter(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo)
+void StackManager::FunctionEnter(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
   if (m_corProfilerInfo == nullptr)
     return;
 
+  HookLatencySample sample;
+
   ThreadID tid = 0;
   if (FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0)
     return;
 
   auto &state = GetOrCreateThreadState(tid);
   std::lock_guard<std::mutex> guard(state.mutex);
+  // The stub checked the mode without this lock. A switch to Off since then has already reset
+  // this stack, and a frame pushed now would outlive it, so check again under the lock.
+  if (!IsTracingEnabled())
+    return;
+  sample.histogram = &state.counters.enterCycles;
+  BumpCounter(state.counters.enters);
+  BumpCounter(state.generation);
+
+  const auto mode = GetMode();
+
+  // Everything above the cap is only counted; PopLeavingFrame consumes the matching leaves.
+  if (state.overflowDepth > 0 || (m_config.maxStackDepth != 0 && state.frames.size() >= m_config.maxStackDepth))
+  {
+    state.overflowDepth++;
+    BumpCounter(state.counters.depthCapDrops);
+    if (state.flight != nullptr)
+      state.flight->Record(FlightEventKind::Enter, id.functionID, ReadTsc());
+    return;
+  }
+
+  // Deep direct recursion is folded into the top frame, which skips symbolization and keeps
+  // the vector from growing. Folded activations are not timed on their own: their exclusive
+  // time accrues to the folded frame.
+  if (!state.frames.empty())
+  {
+    StackFrame &top = state.frames.back();
+    if (top.functionId == id.functionID && m_config.foldRecursionAfter != 0 && top.run >= m_config.foldRecursionAfter)
+    {
+      top.repeat++;
+      BumpCounter(state.counters.foldedEnters);
+      if (top.cctNode != CallingContextTree::kRoot && state.cct != nullptr)
+        state.cct->Node(top.cctNode).calls++;
+      if (state.flight != nullptr)
+        state.flight->Record(FlightEventKind::Enter, id.functionID, ReadTsc());
+      return;
+    }
+  }
 
   StackFrame stackFrame;
   stackFrame.functionId = id.functionID;
+  stackFrame.stackPointer = stackPointer;
+  if (!state.frames.empty() && state.frames.back().functionId == id.functionID)
+    stackFrame.run = state.frames.back().run + 1;
 
+  // eltInfo cannot be queried when the event mask asked for neither frame info nor arguments;
+  // the bench passes 0 for that profile.
   COR_PRF_FRAME_INFO frameInfo = NULL;
-  ULONG argumentInfoSize = 0;
-  m_corProfilerInfo->GetFunctionEnter3Info(id.functionID, eltInfo, &frameInfo, &argumentInfoSize, NULL);
-  stackFrame.functionInfo = GetOrBuildFunctionInfo(id.functionID, frameInfo);
+  if (eltInfo != 0 && m_config.WantsEltInfo())
+  {
+    ULONG argumentInfoSize = 0;
+    m_corProfilerInfo->GetFunctionEnter3Info(id.functionID, eltInfo, &frameInfo, &argumentInfoSize, NULL);
+  }
+  uint64_t buildCycles = 0;
+  stackFrame.enterGeneration = state.generation.load(std::memory_order_relaxed);
+  stackFrame.functionInfo = GetOrBuildFunctionInfo(id.functionID, frameInfo, &buildCycles);
+  stackFrame.assemblyIndex = stackFrame.functionInfo->assemblyIndex;
+  if (buildCycles == 0)
+  {
+    BumpCounter(state.counters.functionInfoCacheHits);
+  }
+  else
+  {
+    BumpCounter(state.counters.functionInfoCacheMisses);
+    BumpCounter(state.counters.symbolizationCycles, buildCycles);
+  }
+
+  if (m_config.callingContextTree)
+  {
+    if (state.cct == nullptr)
+      state.cct = std::make_unique<CallingContextTree>(m_config.cctMaxNodes);
+    uint32_t parent = state.frames.empty() ? CallingContextTree::kRoot : state.frames.back().cctNode;
+    stackFrame.cctNode = state.cct->FindOrAddChild(parent, id.functionID);
+    state.cct->Node(stackFrame.cctNode).calls++;
+  }
 
-  // GetArgumentInfo(id, eltInfo, stackFrame.argumentInfo);
+  if (mode == TracerMode::StacksArgs)
+  {
+    GetArgumentInfo(id, eltInfo, stackFrame.argumentInfo);
+  }
+  if (mode == TracerMode::Timing || m_slowCalls != nullptr || m_config.assemblyTime)
+  {
+    stackFrame.enterTimestamp = ReadTsc();
+  }
 
   // stackFrame.DebugPrint();
 
+  if (state.flight != nullptr)
+    state.flight->Record(FlightEventKind::Enter, id.functionID, stackFrame.enterTimestamp != 0 ? stackFrame.enterTimestamp : ReadTsc());
+
   state.EnsureInit();
   state.frames.push_back(std::move(stackFrame));
+  if (state.frames.size() > state.counters.maxStackDepth.load(std::memory_order_relaxed))
+    state.counters.maxStackDepth.store(state.frames.size(), std::memory_order_relaxed);
 
   // LOG_F(INFO, "FunctionEnter: %d, duration: %lld us", id.functionID, duration.count());
   // Dump();
@@ -309,18 +558,19 @@ void StackManager::FunctionEnter(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltIn
   // LOG_F(INFO, "FunctionEnter: %d", id.functionID);
 }
 
-FunctionInfo StackManager::BuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo)
+const StackManager::ModuleNames &StackManager::GetOrReadModuleNames(ModuleID moduleId)
 {
-  FunctionInfo info;
-  ClassID classId;
-  ModuleID moduleId;
-  mdToken mdtokenFunction;
-
-  m_corProfilerInfo->GetFunctionInfo(id, &classId, &moduleId, &mdtokenFunction);
+  {
+    std::shared_lock lock(m_symbolCacheMutex);
+    auto it = m_moduleNames.find(moduleId);
+    if (it != m_moduleNames.end())
+      return *it->second;
+  }
 
+  auto names = std::make_unique<ModuleNames>();
   LPCBYTE loadAddress;
   ULONG nameLen = 0;
-  AssemblyID assemblyId;
+  AssemblyID assemblyId = 0;
 
   auto hr = m_corProfilerInfo->GetModuleInfo(moduleId, &loadAddress, nameLen, &nameLen, NULL, &assemblyId);
   if (SUCCEEDED(hr))
@@ -329,7 +579,7 @@ FunctionInfo StackManager::BuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO f
     m_corProfilerInfo->GetModuleInfo(moduleId, &loadAddress, nameLen, &nameLen, pszName,
                                      &assemblyId);
 
-    info.moduleName = WStrToUtf8(pszName);
+    names->moduleName = WStrToUtf8(pszName);
     delete[] pszName;
   }
 
@@ -338,73 +588,302 @@ FunctionInfo StackManager::BuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO f
   {
     WCHAR *pszName = new WCHAR[nameLen]; // count the trailing \0
     hr = m_corProfilerInfo->GetAssemblyInfo(assemblyId, nameLen, &nameLen, pszName, NULL, NULL);
-    info.assemblyName = WStrToUtf8(pszName);
+    names->assemblyName = WStrToUtf8(pszName);
     delete[] pszName;
   }
 
-  if (classId == 0)
+  std::unique_lock lock(m_symbolCacheMutex);
+  if (!names->assemblyName.empty())
+  {
+    auto [it, inserted] = m_assemblyIndexes.try_emplace(names->assemblyName, static_cast<uint32_t>(m_assemblyNames.size()));
+    if (inserted)
+      m_assemblyNames.push_back(names->assemblyName);
+    names->assemblyIndex = it->second;
+  }
+  if (IsModuleUnloading(moduleId))
+  {
+    // Already evicted: park it with the retired entries, which outlive the caller's
+    // SymbolReadScope, instead of caching it.
+    const ModuleNames &uncached = *names;
+    std::lock_guard<std::mutex> guard(m_retiredSymbolsMutex);
+    m_retiredSymbols.modules.push_back(std::move(names));
+    return uncached;
+  }
+  return *m_moduleNames.try_emplace(moduleId, std::move(names)).first->second;
+}
+
+const MethodTokenInfo *StackManager::GetOrReadMethodToken(ModuleID moduleId, mdMethodDef token)
+{
+  const MethodTokenKey key{moduleId, token};
+  {
+    std::shared_lock lock(m_symbolCacheMutex);
+    auto it = m_methodTokens.find(key);
+    if (it != m_methodTokens.end())
+    {
+      m_methodTokenCacheHits.fetch_add(1, std::memory_order_relaxed);
+      return it->second.get();
+    }
+  }
+
+  IMetaDataImport2 *pMetaDataImport = nullptr;
+  if (FAILED(m_corProfilerInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport2, reinterpret_cast<IUnknown **>(&pMetaDataImport))) || pMetaDataImport == nullptr)
+    return nullptr;
+  auto info = std::make_unique<MethodTokenInfo>();
+  bool read = ReadMethodTokenInfo(m_corProfilerInfo, pMetaDataImport, moduleId, token, *info);
+  pMetaDataImport->Release();
+  if (!read)
+    return nullptr;
+
+  m_methodTokenCacheMisses.fetch_add(1, std::memory_order_relaxed);
+  std::unique_lock lock(m_symbolCacheMutex);
+  if (IsModuleUnloading(moduleId))
   {
-    hr = m_corProfilerInfo->GetFunctionInfo2(id, frameInfo, &classId, &moduleId, &mdtokenFunction, 0, NULL, NULL);
+    const MethodTokenInfo *uncached = info.get();
+    std::lock_guard<std::mutex> guard(m_retiredSymbolsMutex);
+    m_retiredSymbols.methodTokens.push_back(std::move(info));
+    return uncached;
   }
+  return m_methodTokens.try_emplace(key, std::move(info)).first->second.get();
+}
+
+FunctionInfo StackManager::BuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo)
+{
+  // The module names and method token below are cache entries an unload may evict while this
+  // runs; the scope keeps them alive until everything needed has been copied into info.
+  SymbolReadScope symbols(*this);
+  FunctionInfo info;
+  ClassID classId;
+  ModuleID moduleId;
+  mdToken mdtokenFunction;
+
+  m_corProfilerInfo->GetFunctionInfo(id, &classId, &moduleId, &mdtokenFunction);
+
+  info.moduleId = moduleId;
+  const ModuleNames &names = GetOrReadModuleNames(moduleId);
+  info.moduleName = names.moduleName;
+  info.assemblyName = names.assemblyName;
+  info.assemblyIndex = names.assemblyIndex;
+
+  // Shared generic code reports no class without a frame; the method instantiation comes from
+  // the same call.
+  ULONG32 typeArgsCount = 0;
+  ClassID frameClassId = 0;
+  m_corProfilerInfo->GetFunctionInfo2(id, frameInfo, &frameClassId, &moduleId, &mdtokenFunction, 0, &typeArgsCount, NULL);
+  if (classId == 0)
+    classId = frameClassId;
 
   const ULONG bufferLen = 1024;
   WCHAR pszName[bufferLen];
   GetTypeName(m_corProfilerInfo, NULL, classId, moduleId, pszName, bufferLen);
   info.typeName = WStrToUtf8(pszName);
 
-  std::string methodSignature = GetMethodSignature(m_corProfilerInfo, id, frameInfo, info.typeName);
-  info.methodSignature = methodSignature;
+  const MethodTokenInfo *token = GetOrReadMethodToken(moduleId, (mdMethodDef)mdtokenFunction);
+  if (token != nullptr)
+  {
+    if (typeArgsCount == 0)
+    {
+      info.methodSignature = ComposeMethodSignature(token->returnType, info.typeName, token->name, token->parameters);
+    }
+    else
+    {
+      // Only instantiated generic methods re-render their types, from the cached blob.
+      std::vector<ClassID> typeArgs(typeArgsCount);
+      m_corProfilerInfo->GetFunctionInfo2(id, frameInfo, &frameClassId, &moduleId, &mdtokenFunction, typeArgsCount, &typeArgsCount, typeArgs.data());
+      IMetaDataImport2 *pMetaDataImport = nullptr;
+      if (SUCCEEDED(m_corProfilerInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport2, reinterpret_cast<IUnknown **>(&pMetaDataImport))) && pMetaDataImport != nullptr)
+      {
+        std::string returnType;
+        std::string parameters;
+        if (!FormatMethodTypes(m_corProfilerInfo, pMetaDataImport, moduleId, *token, typeArgs.data(), typeArgsCount, returnType, parameters))
+        {
+          returnType = token->returnType;
+          parameters = token->parameters;
+        }
+        pMetaDataImport->Release();
+        info.methodSignature = ComposeMethodSignature(returnType, info.typeName, token->name, parameters);
+      }
+    }
+
+    if (m_config.captureReturns && MatchesAnyFilter(info.methodSignature, m_config.returnFilter))
+      info.returnType = GetReturnElementType(*token);
+  }
+  if (m_slowCalls != nullptr)
+    info.slowCallCycles = SlowCallCyclesFor(info.methodSignature);
+  info.internedAssemblyName = m_internedNames.Intern(info.assemblyName);
+  info.internedTypeName = m_internedNames.Intern(info.typeName);
+  info.internedMethodSignature = m_internedNames.Intern(info.methodSignature);
   return info;
 }
 
-void StackManager::FunctionLeave(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo)
+void StackManager::FunctionLeave(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
-  (void)eltInfo;
-
   if (m_corProfilerInfo == nullptr)
     return;
 
+  HookLatencySample sample;
+
   ThreadID tid = 0;
   if (FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0)
     return;
 
   auto &state = GetOrCreateThreadState(tid);
   std::lock_guard<std::mutex> guard(state.mutex);
+  if (!IsTracingEnabled()) // see FunctionEnter
+    return;
+  sample.histogram = &state.counters.leaveCycles;
+  BumpCounter(state.counters.leaves);
+  if (state.flight != nullptr)
+    state.flight->Record(FlightEventKind::Leave, id.functionID, ReadTsc());
+
+  if (state.returns != nullptr && eltInfo != 0)
+    RecordReturnValue(state, id.functionID, eltInfo);
+
+  PopLeavingFrame(state, id.functionID, stackPointer);
+}
+
+void StackManager::RecordReturnValue(ThreadStackState &state, FunctionID functionId, COR_PRF_ELT_INFO eltInfo)
+{
+  // The filter verdict is cached as the return type on the FunctionInfo the frame already
+  // holds, so unselected methods cost a compare. Leaves that don't match the top frame are
+  // desyncs and are not worth a lookup.
+  if (state.frames.empty() || state.frames.back().functionId != functionId)
+    return;
+  const FunctionInfo *info = state.frames.back().functionInfo;
+  if (info == nullptr || info->returnType == ELEMENT_TYPE_END)
+    return;
+
+  COR_PRF_FRAME_INFO frameInfo = NULL;
+  COR_PRF_FUNCTION_ARGUMENT_RANGE range{};
+  if (FAILED(m_corProfilerInfo->GetFunctionLeave3Info(functionId, eltInfo, &frameInfo, &range)) || range.startAddress == 0)
+    return;
+
+  ReturnRecord record{};
+  record.functionId = functionId;
+  record.tsc = ReadTsc();
+  record.elementType = static_cast<uint8_t>(info->returnType);
+  const UINT_PTR start = range.startAddress;
+  switch (info->returnType)
+  {
+  case ELEMENT_TYPE_STRING:
+  {
+    // Only a prefix is kept; the object may be gone by the time anyone dumps.
+    UINT_PTR objRef = *reinterpret_cast<const UINT_PTR *>(start);
+    ULONG lengthOffset = 0;
+    ULONG bufferOffset = 0;
+    if (objRef == 0)
+      record.isNull = 1;
+    else if (SUCCEEDED(m_corProfilerInfo->GetStringLayout2(&lengthOffset, &bufferOffset)))
+    {
+      auto base = reinterpret_cast<const std::byte *>(objRef);
+      std::memcpy(&record.length, base + lengthOffset, sizeof(record.length));
+      std::memcpy(&record.value, base + bufferOffset, std::min<size_t>(record.length, 4) * sizeof(WCHAR));
+    }
+    break;
+  }
+  case ELEMENT_TYPE_CLASS:
+  case ELEMENT_TYPE_OBJECT:
+  case ELEMENT_TYPE_SZARRAY:
+  case ELEMENT_TYPE_ARRAY:
+  {
+    UINT_PTR objRef = *reinterpret_cast<const UINT_PTR *>(start);
+    ClassID classId = 0;
+    if (objRef == 0)
+      record.isNull = 1;
+    else if (SUCCEEDED(m_corProfilerInfo->GetClassFromObject(static_cast<ObjectID>(objRef), &classId)))
+      record.value = classId;
+    break;
+  }
+  default:
+    std::memcpy(&record.value, reinterpret_cast<const void *>(start), std::min<size_t>({range.length, sizeof(record.value), ElementSizeBytes(nullptr, info->returnType, 0)}));
+    break;
+  }
+  state.returns->Push(record);
+}
 
+void StackManager::PopLeavingFrame(ThreadStackState &state, FunctionID functionId, UINT_PTR stackPointer)
+{
   auto &frames = state.frames;
+  BumpCounter(state.generation);
+
+  // Activations past the depth cap are only counted, so they are matched by depth: while any
+  // are outstanding, a leave belongs to the innermost of them. Their unwinds are reported one by
+  // one like leaves, so the count only drifts after a missed leave, and the FunctionID search
+  // below repairs the recorded frames once it is used up.
+  if (state.overflowDepth > 0)
+  {
+    state.overflowDepth--;
+    return;
+  }
+
   if (frames.empty())
     return;
 
-  if (frames.back().functionId == id.functionID)
+  const auto &top = frames.back();
+  if (top.functionId == functionId)
   {
-    frames.pop_back();
+    // A folded frame keeps its outermost activation's SP, so an exact match means the inner
+    // activations were unwound without leaves and the whole frame goes.
+    if (stackPointer != 0 && top.stackPointer == stackPointer)
+      PopFrames(state, frames.size() - 1);
+    else
+      LeaveTopFrame(state);
     return;
   }
 
+  // Leaves were missed. The leaving frame is identified by FunctionID; the SP only picks among
+  // activations of the same function: one entered at exactly the leaving SP wins, otherwise the
+  // topmost activation does. Enter and leave SPs are only ever compared for equality, never for
+  // order, since nothing guarantees that the runtime's enter and leave helpers run at the same
+  // depth. This path only runs after a missed leave, so it can afford to search the whole stack.
+  size_t leaving = frames.size();
+  bool exact = false;
   for (size_t i = frames.size(); i-- > 0;)
   {
-    if (frames[i].functionId == id.functionID)
+    const StackFrame &frame = frames[i];
+    if (frame.functionId != functionId)
+      continue;
+    if (stackPointer != 0 && frame.stackPointer == stackPointer)
     {
-      state.desyncFoundNotTop++;
-      frames.resize(i);
-      if ((state.desyncFoundNotTop & 0x3FFu) == 0)
-      {
-        LOG("WARNING: Leave desync repaired (count=%u)", state.desyncFoundNotTop);
-      }
-      return;
+      leaving = i;
+      exact = true;
+      break;
+    }
+    if (leaving == frames.size())
+    {
+      leaving = i;
+      if (stackPointer == 0)
+        break;
+    }
+  }
+
+  if (leaving == frames.size())
+  {
+    state.desyncNotFound++;
+    if ((state.desyncNotFound & 0x3FFu) == 0) // every 1024 times
+    {
+      LOG("WARNING: Leave desync not found (count=%u)", state.desyncNotFound);
     }
+    return;
   }
 
-  state.desyncNotFound++;
-  if ((state.desyncNotFound & 0x3FFu) == 0) // every 1024 times
+  if (leaving != frames.size() - 1)
   {
-    LOG("WARNING: Leave desync not found (count=%u)", state.desyncNotFound);
+    state.desyncFoundNotTop++;
+    if ((state.desyncFoundNotTop & 0x3FFu) == 0)
+    {
+      LOG("WARNING: Leave desync repaired (count=%u)", state.desyncFoundNotTop);
+    }
   }
+  // Callees above the leaving frame never reported their leaves.
+  PopFrames(state, leaving + 1, true);
+  if (exact)
+    PopFrames(state, leaving);
+  else
+    LeaveTopFrame(state);
 }
 
-void StackManager::FunctionTailcall(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo)
+void StackManager::FunctionTailcall(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer)
 {
-  (void)id;
   (void)eltInfo;
 
   if (m_corProfilerInfo == nullptr)
@@ -416,22 +895,147 @@ void StackManager::FunctionTailcall(FunctionIDOrClientID id, COR_PRF_ELT_INFO el
 
   auto &state = GetOrCreateThreadState(tid);
   std::lock_guard<std::mutex> guard(state.mutex);
+  if (!IsTracingEnabled()) // see FunctionEnter
+    return;
+  BumpCounter(state.counters.tailcalls);
+  if (state.flight != nullptr)
+    state.flight->Record(FlightEventKind::Tailcall, id.functionID, ReadTsc());
 
-  auto &frames = state.frames;
-  if (frames.empty())
+  if (state.frames.empty())
     return;
 
-  frames.pop_back();
+  // The tail-calling function's frame is replaced by its callee, so it leaves here.
+  PopLeavingFrame(state, id.functionID, stackPointer);
   state.tailcallPops++;
 }
 
-void StackManager::OnUnmanagedToManaged(FunctionID functionId, COR_PRF_TRANSITION_REASON reason)
+void StackManager::LeaveTopFrame(ThreadStackState &state)
+{
+  auto &top = state.frames.back();
+  if (top.repeat > 0)
+  {
+    top.repeat--;
+    return;
+  }
+  PopFrames(state, state.frames.size() - 1);
+}
+
+void StackManager::PopFrames(ThreadStackState &state, size_t newSize, bool missedLeave)
+{
+  auto &frames = state.frames;
+  uint64_t now = 0;
+  bool timing = false;
+  while (frames.size() > newSize)
+  {
+    const StackFrame &frame = frames.back();
+    // When a missed frame really returned is unknown, so it has no duration to charge anywhere;
+    // its caller's inclusive time still covers it.
+    if (frame.enterTimestamp != 0 && !missedLeave)
+    {
+      if (now == 0)
+      {
+        now = ReadTsc();
+        timing = GetMode() == TracerMode::Timing;
+      }
+      const uint64_t inclusive = now > frame.enterTimestamp ? now - frame.enterTimestamp : 0;
+      if (inclusive > frame.functionInfo->slowCallCycles)
+        RecordSlowCall(state, now);
+      if (timing)
+        RecordFrameTiming(state, frame, inclusive);
+      if (m_config.assemblyTime)
+      {
+        // Callees' time is already in childCycles, so a plugin called back from the host (or the
+        // host called from a plugin) is charged only for its own frames.
+        if (frame.assemblyIndex >= state.assemblyTime.size())
+          state.assemblyTime.resize(frame.assemblyIndex + 1);
+        auto &charge = state.assemblyTime[frame.assemblyIndex];
+        charge.exclusiveCycles += inclusive > frame.childCycles ? inclusive - frame.childCycles : 0;
+        charge.calls++;
+      }
+      // `frame` is still frames.back(), so the caller is the one below it.
+      if (frames.size() >= 2)
+        frames[frames.size() - 2].childCycles += inclusive;
+    }
+    frames.pop_back();
+  }
+}
+
+void StackManager::RecordFrameTiming(ThreadStackState &state, const StackFrame &frame, uint64_t inclusive)
+{
+  const uint64_t exclusive = inclusive > frame.childCycles ? inclusive - frame.childCycles : 0;
+
+  auto &entry = state.profile[frame.functionId];
+  entry.calls++;
+  entry.inclusiveCycles += inclusive;
+  entry.exclusiveCycles += exclusive;
+  entry.histogram[std::min<size_t>(std::bit_width(inclusive), kProfileHistogramBuckets - 1)]++;
+
+  if (frame.cctNode != CallingContextTree::kRoot && state.cct != nullptr)
+  {
+    auto &node = state.cct->Node(frame.cctNode);
+    node.inclusiveCycles += inclusive;
+    node.exclusiveCycles += exclusive;
+  }
+}
+
+void StackManager::OnExceptionUnwindFunctionEnter(FunctionID functionId)
+{
+  if (m_corProfilerInfo == nullptr)
+    return;
+
+  ThreadID tid = 0;
+  if (FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0)
+    return;
+
+  auto &state = GetOrCreateThreadState(tid);
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.unwindingFunctionIds.push_back(functionId);
+}
+
+void StackManager::OnExceptionUnwindFunctionLeave()
 {
-  (void)reason;
+  if (m_corProfilerInfo == nullptr)
+    return;
+
+  ThreadID tid = 0;
+  if (FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0)
+    return;
 
+  auto &state = GetOrCreateThreadState(tid);
+  std::lock_guard<std::mutex> guard(state.mutex);
+
+  // The runtime skips the Leave hook for unwound frames; this callback stands in for it.
+  if (state.unwindingFunctionIds.empty())
+    return;
+  FunctionID functionId = state.unwindingFunctionIds.back();
+  state.unwindingFunctionIds.pop_back();
+
+  state.exceptionUnwindPops++;
+  if (state.flight != nullptr)
+    state.flight->Record(FlightEventKind::Unwind, functionId, ReadTsc());
+  PopLeavingFrame(state, functionId, 0);
+}
+
+void StackManager::OnUnmanagedToManaged(FunctionID functionId, COR_PRF_TRANSITION_REASON reason)
+{
   if (m_corProfilerInfo == nullptr)
     return;
 
+  if (m_config.flightRecorderEvents != 0 && IsTracingEnabled())
+  {
+    // Only the owning thread writes its ring, so no state lock is needed here.
+    ThreadID tid = 0;
+    if (SUCCEEDED(m_corProfilerInfo->GetCurrentThreadID(&tid)) && tid != 0)
+    {
+      auto &state = GetOrCreateThreadState(tid);
+      if (state.flight != nullptr)
+      {
+        auto kind = reason == COR_PRF_TRANSITION_CALL ? FlightEventKind::TransitionCall : FlightEventKind::TransitionReturn;
+        state.flight->Record(kind, functionId, ReadTsc());
+      }
+    }
+  }
+
   std::shared_lock lock(m_functionInfosMutex);
 
   const FunctionInfo *info = nullptr;
@@ -444,143 +1048,1759 @@ void StackManager::OnUnmanagedToManaged(FunctionID functionId, COR_PRF_TRANSITIO
   {
     return;
   }
-  lock.unlock();
 
   auto now = std::chrono::steady_clock::now();
 
+  // Still holding the function info lock, so an unload cannot evict info before it is recorded.
   std::unique_lock lock2(m_unmanagedToManagedTransitionsMutex);
   auto &record = m_unmanagedToManagedTransitions[functionId];
   record.functionInfo = info;
   record.lastTimestamp = now;
 }
 
-void StackManager::SetCorProfilerInfo(ICorProfilerInfo15 *corProfilerInfo)
+void StackManager::OnFunctionUnloadStarted(FunctionID functionId)
 {
-  m_corProfilerInfo = corProfilerInfo;
+  std::vector<std::pair<FunctionID, std::unique_ptr<FunctionInfo>>> evicted;
+  {
+    std::unique_lock lock(m_functionInfosMutex);
+    auto it = m_functionInfos.find(functionId);
+    if (it == m_functionInfos.end())
+      return;
+    evicted.emplace_back(it->first, std::move(it->second));
+    m_functionInfos.erase(it);
+  }
+  RetireFunctionInfos(std::move(evicted));
 }
 
-ICorProfilerInfo15 *StackManager::GetCorProfilerInfo()
+void StackManager::OnModuleUnloadStarted(ModuleID moduleId)
 {
-  return m_corProfilerInfo;
-}
+  // Marked before evicting, so a build racing with the eviction either lands in the caches
+  // first and is evicted below, or sees the mark and does not cache.
+  {
+    std::lock_guard<std::mutex> guard(m_unloadingModulesMutex);
+    m_unloadingModules.insert(moduleId);
+  }
 
-void StackManager::OnThreadCreated(ThreadID threadId)
-{
-  auto &state = GetOrCreateThreadState(threadId);
-  std::lock_guard<std::mutex> guard(state.mutex);
-  state.EnsureInit();
+  std::vector<std::pair<FunctionID, std::unique_ptr<FunctionInfo>>> evicted;
+  {
+    std::unique_lock lock(m_functionInfosMutex);
+    for (auto it = m_functionInfos.begin(); it != m_functionInfos.end();)
+    {
+      if (it->second->moduleId == moduleId)
+      {
+        evicted.emplace_back(it->first, std::move(it->second));
+        it = m_functionInfos.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  RetiredSymbols retired;
+  {
+    std::unique_lock lock(m_symbolCacheMutex);
+    for (auto it = m_methodTokens.begin(); it != m_methodTokens.end();)
+    {
+      if (it->first.moduleId == moduleId)
+      {
+        retired.methodTokens.push_back(std::move(it->second));
+        it = m_methodTokens.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    auto module = m_moduleNames.find(moduleId);
+    if (module != m_moduleNames.end())
+    {
+      retired.modules.push_back(std::move(module->second));
+      m_moduleNames.erase(module);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_retiredSymbolsMutex);
+    for (auto &token : retired.methodTokens)
+      m_retiredSymbols.methodTokens.push_back(std::move(token));
+    for (auto &module : retired.modules)
+      m_retiredSymbols.modules.push_back(std::move(module));
+  }
+
+  if (!evicted.empty())
+    LOG("Module 0x%llx unloading: evicted %zu functions", (unsigned long long)moduleId, evicted.size());
+  RetireFunctionInfos(std::move(evicted));
+}
+
+void StackManager::OnModuleUnloadFinished(ModuleID moduleId)
+{
+  // The ID may be handed to a new module from here on.
+  std::lock_guard<std::mutex> guard(m_unloadingModulesMutex);
+  m_unloadingModules.erase(moduleId);
+}
+
+bool StackManager::IsModuleUnloading(ModuleID moduleId) const
+{
+  std::lock_guard<std::mutex> guard(m_unloadingModulesMutex);
+  return m_unloadingModules.count(moduleId) != 0;
+}
+
+void StackManager::OnAssemblyUnloadFinished(AssemblyID assemblyId)
+{
+  (void)assemblyId;
+  // Its modules were evicted in ModuleUnloadStarted; this is the point where whatever a dump
+  // was still holding on to can usually go.
+  ReclaimRetiredSymbols();
+}
+
+void StackManager::RetireFunctionInfos(std::vector<std::pair<FunctionID, std::unique_ptr<FunctionInfo>>> evicted)
+{
+  if (evicted.empty())
+  {
+    ReclaimRetiredSymbols();
+    return;
+  }
+
+  std::unordered_map<const FunctionInfo *, FunctionID> infos;
+  for (const auto &kv : evicted)
+    infos.emplace(kv.second.get(), kv.first);
+
+  {
+    std::unique_lock lock(m_unmanagedToManagedTransitionsMutex);
+    for (auto it = m_unmanagedToManagedTransitions.begin(); it != m_unmanagedToManagedTransitions.end();)
+    {
+      if (infos.count(it->second.functionInfo) != 0)
+        it = m_unmanagedToManagedTransitions.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  // Frames still pointing at the evicted entries (leftovers of a desync, or code that was on a
+  // stack when its context unloaded) get the placeholder. Profiles keyed by the evicted
+  // FunctionIDs are dropped so a recycled ID does not inherit them.
+  for (auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (auto &kv : bucket.stacks)
+    {
+      ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+      std::lock_guard<std::mutex> guard(st->mutex);
+      for (auto &frame : st->frames)
+      {
+        if (infos.count(frame.functionInfo) != 0)
+        {
+          frame.functionInfo = &kUnloadedFunctionInfo;
+          BumpCounter(st->generation);
+        }
+      }
+      for (const auto &info : infos)
+        st->profile.erase(info.second);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    for (const auto &info : infos)
+      m_retiredProfile.erase(info.second);
+  }
+  {
+    std::unordered_set<FunctionID> ids;
+    for (const auto &info : infos)
+      ids.insert(info.second);
+    {
+      std::lock_guard<std::mutex> guard(m_allocationsMutex);
+      for (auto it = m_allocations.begin(); it != m_allocations.end();)
+        it = ids.count(it->first.functionId) != 0 ? m_allocations.erase(it) : std::next(it);
+    }
+    std::lock_guard<std::mutex> guard(m_gcMutex);
+    for (auto it = m_gcTriggerStacks.begin(); it != m_gcTriggerStacks.end();)
+    {
+      bool evictedFrame = std::any_of(it->first.begin(), it->first.end(), [&](FunctionID id) { return ids.count(id) != 0; });
+      it = evictedFrame ? m_gcTriggerStacks.erase(it) : std::next(it);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_retiredSymbolsMutex);
+    for (auto &kv : evicted)
+      m_retiredSymbols.functions.push_back(std::move(kv.second));
+  }
+  ReclaimRetiredSymbols();
+}
+
+void StackManager::ReclaimRetiredSymbols() const
+{
+  RetiredSymbols garbage;
+  {
+    std::lock_guard<std::mutex> guard(m_retiredSymbolsMutex);
+    // Pairs with the seq_cst increment in SymbolReadScope: a reader that opened after this load
+    // cannot have seen any of the unlinked entries.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_symbolReaders.load(std::memory_order_seq_cst) != 0)
+      return;
+    std::swap(garbage, m_retiredSymbols);
+  }
+}
+
+bool StackManager::SetMode(TracerMode mode)
+{
+  if (static_cast<uint32_t>(mode) > static_cast<uint32_t>(TracerMode::Timing))
+    return false;
+  if (mode == TracerMode::StacksArgs && !m_config.captureArgs)
+  {
+    LOG("WARNING: StacksArgs mode needs SW2TRACER_ARGS=1 at startup");
+    return false;
+  }
+
+  auto previous = static_cast<TracerMode>(g_TracerMode.exchange(static_cast<uint32_t>(mode), std::memory_order_acq_rel));
+  if (previous == mode)
+    return true;
+
+  // Leaves are not observed while off, so whatever is on the shadow stacks is stale either way.
+  if (previous == TracerMode::Off || mode == TracerMode::Off)
+    ResetAllStacks();
+
+  LOG("Tracer mode changed: %u -> %u", static_cast<unsigned>(previous), static_cast<unsigned>(mode));
+  return true;
+}
+
+TracerMode StackManager::GetMode() const
+{
+  return static_cast<TracerMode>(g_TracerMode.load(std::memory_order_relaxed));
+}
+
+void StackManager::ResetAllStacks()
+{
+  for (auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (auto &kv : bucket.stacks)
+    {
+      ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+
+      std::lock_guard<std::mutex> guard(st->mutex);
+      st->frames.clear();
+      st->overflowDepth = 0;
+      BumpCounter(st->generation);
+    }
+  }
+}
+
+void StackManager::SetConfig(const TracerConfig &config)
+{
+  m_config = config;
+
+  m_gcPauses.reset();
+  if (config.gcTracking && config.gcRecords != 0)
+    m_gcPauses = std::make_unique<GcPauseRecorder>(config.gcRecords);
+
+  m_slowCalls.reset();
+  m_slowCallRules.clear();
+  m_slowCallDefaultCycles = UINT64_MAX;
+  if (!config.WantsSlowCalls())
+    return;
+
+  if (config.slowCallThresholdUs != 0)
+    m_slowCallDefaultCycles = NanosecondsToTsc(config.slowCallThresholdUs * 1000ull);
+  size_t start = 0;
+  while (start < config.slowCallFilter.size())
+  {
+    size_t end = config.slowCallFilter.find(',', start);
+    if (end == std::string::npos)
+      end = config.slowCallFilter.size();
+    std::string entry = config.slowCallFilter.substr(start, end - start);
+    start = end + 1;
+
+    uint64_t cycles = m_slowCallDefaultCycles;
+    size_t eq = entry.rfind('=');
+    if (eq != std::string::npos)
+    {
+      cycles = NanosecondsToTsc(std::strtoull(entry.c_str() + eq + 1, nullptr, 10) * 1000ull);
+      entry.resize(eq);
+    }
+    if (entry.empty() || cycles == UINT64_MAX)
+    {
+      LOG("WARNING: ignoring slow-call filter entry '%s' (no pattern, or no threshold and SW2TRACER_SLOW_CALL_US unset)", entry.c_str());
+      continue;
+    }
+    m_slowCallRules.emplace_back(std::move(entry), cycles);
+  }
+  if (!config.slowCallFilter.empty() && m_slowCallRules.empty())
+    return;
+
+  m_slowCalls = std::make_unique<SlowCallLog>(config.slowCallRecords);
+  LOG("Logging calls slower than %u us (%zu method pattern(s)) into %u records", config.slowCallThresholdUs, m_slowCallRules.size(), config.slowCallRecords);
+}
+
+uint64_t StackManager::SlowCallCyclesFor(const std::string &methodSignature) const
+{
+  if (m_slowCallRules.empty())
+    return m_slowCallDefaultCycles;
+  for (const auto &rule : m_slowCallRules)
+  {
+    if (methodSignature.find(rule.first) != std::string::npos)
+      return rule.second;
+  }
+  return UINT64_MAX;
+}
+
+void StackManager::RecordSlowCall(const ThreadStackState &state, uint64_t now)
+{
+  // Called with the slow frame still on top; build the record on the stack, the log copies it.
+  const auto &frames = state.frames;
+  SlowCallRecord record;
+  record.threadId = state.threadId;
+  record.leaveTsc = now;
+  record.durationCycles = now - frames.back().enterTimestamp;
+  record.depth = static_cast<uint32_t>(frames.size() + state.overflowDepth);
+  record.frameCount = static_cast<uint32_t>(std::min<size_t>(frames.size(), SlowCallRecord::kMaxFrames));
+  for (uint32_t i = 0; i < record.frameCount; i++)
+    record.frames[i] = frames[frames.size() - 1 - i].functionId;
+  m_slowCalls->Push(record);
+}
+
+namespace
+{
+  void FillFrame(SW2TracerFrame &out, FunctionID functionId, const FunctionInfo *info, uint32_t repeat)
+  {
+    out.functionId = functionId;
+    out.assemblyName = info != nullptr ? info->internedAssemblyName : "";
+    out.typeName = info != nullptr ? info->internedTypeName : "";
+    out.methodSignature = info != nullptr ? info->internedMethodSignature : "";
+    out.repeat = repeat;
+    out.reserved = 0;
+  }
+}
+
+size_t StackManager::GetStack(ThreadID tid, SW2TracerFrame *frames, size_t maxFrames, size_t *depth) const
+{
+  if (depth != nullptr)
+    *depth = 0;
+  if (tid == 0 && (m_corProfilerInfo == nullptr || FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0))
+    return 0;
+
+  // The frames' FunctionInfos are only dereferenced here; the names they point to are interned.
+  // Freeing retired entries is left to others, so a query never releases memory.
+  SymbolReadScope symbols(*this, false);
+  const auto &bucket = m_threadBuckets[BucketIndex(tid)];
+  std::shared_lock bucketLock(bucket.mutex);
+  auto it = bucket.stacks.find(tid);
+  if (it == bucket.stacks.end() || it->second == nullptr)
+    return 0;
+
+  const ThreadStackState &state = *it->second;
+  std::lock_guard<std::mutex> guard(state.mutex);
+  if (depth != nullptr)
+    *depth = state.frames.size() + state.overflowDepth;
+  size_t written = 0;
+  if (frames == nullptr)
+    return 0;
+  for (auto frame = state.frames.rbegin(); frame != state.frames.rend() && written < maxFrames; ++frame, ++written)
+    FillFrame(frames[written], frame->functionId, frame->functionInfo, frame->repeat);
+  return written;
+}
+
+bool StackManager::LookupFunction(FunctionID functionId, SW2TracerFrame &frame) const
+{
+  std::shared_lock lock(m_functionInfosMutex);
+  auto it = m_functionInfos.find(functionId);
+  if (it == m_functionInfos.end())
+    return false;
+  FillFrame(frame, functionId, it->second.get(), 0);
+  return true;
+}
+
+size_t StackManager::GetSlowCalls(SW2TracerSlowCall *calls, size_t maxCalls) const
+{
+  if (m_slowCalls == nullptr || calls == nullptr || maxCalls == 0)
+    return 0;
+
+  auto records = m_slowCalls->Snapshot(maxCalls);
+  const uint64_t now = ReadTsc();
+  size_t written = 0;
+  for (auto it = records.rbegin(); it != records.rend(); ++it, ++written)
+  {
+    SW2TracerSlowCall &call = calls[written];
+    call.threadId = it->threadId;
+    call.durationNs = TscToNanoseconds(it->durationCycles);
+    call.ageNs = now > it->leaveTsc ? TscToNanoseconds(now - it->leaveTsc) : 0;
+    call.depth = it->depth;
+    call.frameCount = it->frameCount;
+    std::copy(it->frames, it->frames + it->frameCount, call.functionIds);
+  }
+  return written;
+}
+
+std::vector<std::pair<std::string, StackManager::AssemblyTime>> StackManager::CollectAssemblyTime() const
+{
+  std::vector<AssemblyTime> totals;
+  auto merge = [&](const std::vector<AssemblyTime> &from) {
+    if (totals.size() < from.size())
+      totals.resize(from.size());
+    for (size_t i = 0; i < from.size(); i++)
+    {
+      totals[i].exclusiveCycles += from[i].exclusiveCycles;
+      totals[i].calls += from[i].calls;
+    }
+  };
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    merge(m_retiredAssemblyTime);
+  }
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      if (kv.second == nullptr)
+        continue;
+      std::lock_guard<std::mutex> guard(kv.second->mutex);
+      merge(kv.second->assemblyTime);
+    }
+  }
+
+  std::vector<std::pair<std::string, AssemblyTime>> out;
+  {
+    std::shared_lock lock(m_symbolCacheMutex);
+    for (size_t i = 0; i < totals.size(); i++)
+    {
+      if (totals[i].calls != 0)
+        out.emplace_back(i < m_assemblyNames.size() ? m_assemblyNames[i] : "<unknown>", totals[i]);
+    }
+  }
+  std::sort(out.begin(), out.end(), [](const auto &a, const auto &b) {
+    return a.second.exclusiveCycles > b.second.exclusiveCycles;
+  });
+  return out;
+}
+
+size_t StackManager::GetAssemblyTime(SW2TracerAssemblyTime *entries, size_t maxEntries) const
+{
+  if (!m_config.assemblyTime || entries == nullptr)
+    return 0;
+
+  auto totals = CollectAssemblyTime();
+  size_t count = std::min(totals.size(), maxEntries);
+  for (size_t i = 0; i < count; i++)
+  {
+    SW2TracerAssemblyTime &entry = entries[i];
+    const std::string &name = totals[i].first;
+    size_t length = std::min(name.size(), sizeof(entry.assemblyName) - 1);
+    std::memcpy(entry.assemblyName, name.data(), length);
+    entry.assemblyName[length] = '\0';
+    entry.exclusiveNs = TscToNanoseconds(totals[i].second.exclusiveCycles);
+    entry.calls = totals[i].second.calls;
+  }
+  return count;
+}
+
+void StackManager::WriteAssemblyTime(std::ostream &out) const
+{
+  if (!m_config.assemblyTime)
+    return;
+
+  auto totals = CollectAssemblyTime();
+  uint64_t allCycles = 0;
+  for (const auto &kv : totals)
+    allCycles += kv.second.exclusiveCycles;
+
+  out << "Exclusive time by assembly (completed calls, wall clock):" << '\n';
+  if (totals.empty())
+    out << "    (none)" << '\n';
+  for (const auto &kv : totals)
+  {
+    out << "    " << kv.first << ": " << TscToNanoseconds(kv.second.exclusiveCycles) << " ns ("
+        << (allCycles != 0 ? kv.second.exclusiveCycles * 100 / allCycles : 0) << "%), " << kv.second.calls << " calls" << '\n';
+  }
+  out << '\n';
+}
+
+void StackManager::WriteSlowCalls(std::ostream &out) const
+{
+  if (m_slowCalls == nullptr)
+    return;
+
+  auto records = m_slowCalls->Snapshot(m_config.slowCallRecords);
+  out << "Slow calls (most recent first, " << m_slowCalls->Total() << " logged):" << '\n';
+  if (records.empty())
+    out << "    (none)" << '\n';
+  const uint64_t now = ReadTsc();
+  for (auto it = records.rbegin(); it != records.rend(); ++it)
+  {
+    out << "    Thread " << it->threadId << ", " << TscToNanoseconds(it->durationCycles) << " ns, returned "
+        << (now > it->leaveTsc ? TscToNanoseconds(now - it->leaveTsc) : 0) << " ns ago:" << '\n';
+    for (uint32_t i = 0; i < it->frameCount; i++)
+    {
+      const FunctionInfo *info = FindFunctionInfo(it->frames[i]);
+      out << "        " << (info != nullptr ? info->methodSignature : "<unknown>") << '\n';
+    }
+    if (it->depth > it->frameCount)
+      out << "        (" << (it->depth - it->frameCount) << " more frame(s))" << '\n';
+  }
+  out << '\n';
+}
+
+const TracerConfig &StackManager::GetConfig() const
+{
+  return m_config;
+}
+
+void StackManager::SetCorProfilerInfo(ICorProfilerInfo15 *corProfilerInfo)
+{
+  m_corProfilerInfo = corProfilerInfo;
+  (void)TscTicksPerNanosecond();
+}
+
+ICorProfilerInfo15 *StackManager::GetCorProfilerInfo()
+{
+  return m_corProfilerInfo;
+}
+
+void StackManager::OnThreadCreated(ThreadID threadId)
+{
+  auto &state = GetOrCreateThreadState(threadId);
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.EnsureInit();
+}
+
+void StackManager::OnThreadDestroyed(ThreadID threadId)
+{
+  auto &bucket = m_threadBuckets[BucketIndex(threadId)];
+  std::unique_lock lock(bucket.mutex);
+  auto it = bucket.stacks.find(threadId);
+  if (it == bucket.stacks.end())
+    return;
+
+  if (it->second != nullptr)
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    AccumulateStats(*it->second, m_retiredStats);
+
+    std::lock_guard<std::mutex> guard(it->second->mutex);
+    for (const auto &kv : it->second->profile)
+      m_retiredProfile[kv.first].Merge(kv.second);
+    const auto &assemblyTime = it->second->assemblyTime;
+    if (m_retiredAssemblyTime.size() < assemblyTime.size())
+      m_retiredAssemblyTime.resize(assemblyTime.size());
+    for (size_t i = 0; i < assemblyTime.size(); i++)
+    {
+      m_retiredAssemblyTime[i].exclusiveCycles += assemblyTime[i].exclusiveCycles;
+      m_retiredAssemblyTime[i].calls += assemblyTime[i].calls;
+    }
+
+    if (it->second->cct != nullptr)
+    {
+      if (m_retiredCct == nullptr)
+        m_retiredCct = std::make_unique<CallingContextTree>(m_config.cctMaxNodes * 4);
+      m_retiredCct->Merge(*it->second->cct);
+    }
+  }
+  bucket.stacks.erase(it);
+}
+
+void StackManager::OnAllocationSample(ThreadID threadId, const std::basic_string<WCHAR> &typeName, uint64_t bytes)
+{
+  // The sample is delivered on the allocating thread, outside any hook, so its shadow stack is
+  // exactly where the allocation happened.
+  FunctionID functionId = 0;
+  std::string assembly = "<no managed frame>";
+  {
+    auto &bucket = m_threadBuckets[BucketIndex(threadId)];
+    std::shared_lock bucketLock(bucket.mutex);
+    auto it = bucket.stacks.find(threadId);
+    if (it != bucket.stacks.end() && it->second != nullptr)
+    {
+      std::lock_guard<std::mutex> guard(it->second->mutex);
+      if (!it->second->frames.empty())
+      {
+        const StackFrame &top = it->second->frames.back();
+        functionId = top.functionId;
+        assembly = top.functionInfo->assemblyName;
+      }
+    }
+  }
+
+  const char *type = m_internedNames.Intern(WStrToUtf8(typeName));
+  std::lock_guard<std::mutex> guard(m_allocationsMutex);
+  auto &site = m_allocations[AllocationSite{functionId, type}];
+  site.samples++;
+  site.bytes += bytes;
+  auto &byAssembly = m_allocationsByAssembly[assembly];
+  byAssembly.samples++;
+  byAssembly.bytes += bytes;
+  m_allocationTotals.samples++;
+  m_allocationTotals.bytes += bytes;
+}
+
+void StackManager::WriteAllocations(std::ostream &out) const
+{
+  if (!m_config.allocationSampling)
+    return;
+
+  std::lock_guard<std::mutex> guard(m_allocationsMutex);
+  out << "Sampled allocations (AllocationTick, about one sample per 100 KB; " << m_allocationTotals.samples
+      << " samples, " << m_allocationTotals.bytes << " bytes):" << '\n';
+  if (m_allocationTotals.samples == 0)
+  {
+    out << "    (none)" << '\n';
+    out << '\n';
+    return;
+  }
+
+  auto byBytes = [](const auto &a, const auto &b) { return a.second.bytes > b.second.bytes; };
+  auto typeName = [](const char *name) { return *name != '\0' ? name : "<unknown type>"; };
+
+  std::vector<std::pair<std::string, AllocationTotals>> assemblies(m_allocationsByAssembly.begin(), m_allocationsByAssembly.end());
+  std::sort(assemblies.begin(), assemblies.end(), byBytes);
+  out << "  By assembly:" << '\n';
+  for (const auto &kv : assemblies)
+    out << "    " << kv.first << ": " << kv.second.bytes << " bytes, " << kv.second.samples << " samples" << '\n';
+
+  std::unordered_map<FunctionID, AllocationTotals> functions;
+  std::unordered_map<const char *, AllocationTotals> types;
+  std::unordered_map<FunctionID, std::vector<std::pair<const char *, AllocationTotals>>> functionTypes;
+  for (const auto &kv : m_allocations)
+  {
+    auto &function = functions[kv.first.functionId];
+    function.samples += kv.second.samples;
+    function.bytes += kv.second.bytes;
+    auto &type = types[kv.first.typeName];
+    type.samples += kv.second.samples;
+    type.bytes += kv.second.bytes;
+    functionTypes[kv.first.functionId].emplace_back(kv.first.typeName, kv.second);
+  }
+
+  std::vector<std::pair<FunctionID, AllocationTotals>> topFunctions(functions.begin(), functions.end());
+  std::sort(topFunctions.begin(), topFunctions.end(), byBytes);
+  topFunctions.resize(std::min<size_t>(topFunctions.size(), 30));
+  out << "  Top 30 allocating functions (top frame at the sample):" << '\n';
+  for (const auto &kv : topFunctions)
+  {
+    const FunctionInfo *info = kv.first != 0 ? FindFunctionInfo(kv.first) : nullptr;
+    out << "    " << (info != nullptr ? info->methodSignature : kv.first == 0 ? "<no managed frame>" : "<unknown>") << '\n';
+    if (info != nullptr)
+      out << "        Assembly: " << info->assemblyName << '\n';
+    out << "        Bytes: " << kv.second.bytes << ", Samples: " << kv.second.samples << '\n';
+
+    auto &siteTypes = functionTypes[kv.first];
+    std::sort(siteTypes.begin(), siteTypes.end(), byBytes);
+    out << "        Types:";
+    for (size_t i = 0; i < siteTypes.size() && i < 3; i++)
+      out << (i == 0 ? " " : ", ") << typeName(siteTypes[i].first) << " (" << siteTypes[i].second.bytes << ")";
+    out << '\n';
+  }
+
+  std::vector<std::pair<const char *, AllocationTotals>> topTypes(types.begin(), types.end());
+  std::sort(topTypes.begin(), topTypes.end(), byBytes);
+  topTypes.resize(std::min<size_t>(topTypes.size(), 20));
+  out << "  Top 20 allocated types:" << '\n';
+  for (const auto &kv : topTypes)
+    out << "    " << typeName(kv.first) << ": " << kv.second.bytes << " bytes, " << kv.second.samples << " samples" << '\n';
+  out << '\n';
+}
+
+namespace
+{
+  // GC reasons as reported by the GCStart event.
+  const char *GcReasonName(int32_t reason)
+  {
+    static const char *const kNames[] = {
+        "AllocSmall", "Induced", "LowMemory", "Empty", "AllocLarge", "OutOfSpaceSOH", "OutOfSpaceLOH",
+        "InducedNotForced", "Internal", "InducedLowMemory", "InducedCompacting", "LowMemoryHost",
+        "PMFullGC", "LowMemoryHostBlocking"};
+    if (reason < 0)
+      return "unknown";
+    return static_cast<size_t>(reason) < ARRAY_LEN(kNames) ? kNames[reason] : "other";
+  }
+
+  // Collections started by an allocation or by user code; the rest (low memory, internal...) say
+  // little about the stack that happened to be running.
+  bool IsAttributableGcReason(int32_t reason)
+  {
+    switch (reason)
+    {
+    case -1: // no GCStart event: keep the stack rather than lose it
+    case 0:  // AllocSmall
+    case 1:  // Induced
+    case 4:  // AllocLarge
+    case 5:  // OutOfSpaceSOH
+    case 6:  // OutOfSpaceLOH
+    case 7:  // InducedNotForced
+    case 9:  // InducedLowMemory
+    case 10: // InducedCompacting
+      return true;
+    default:
+      return false;
+    }
+  }
+}
+
+void StackManager::OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON reason)
+{
+  if (m_gcPauses == nullptr || (reason != COR_PRF_SUSPEND_FOR_GC && reason != COR_PRF_SUSPEND_FOR_GC_PREP))
+    return;
+
+  // Called on the thread that suspends the runtime: for workstation GCs and GC.Collect that is
+  // the thread whose allocation or call triggered the collection. Other threads are not
+  // suspended yet, so taking the stack locks here cannot wait on a suspended owner.
+  GcPauseRecord record{};
+  record.suspendTsc = ReadTsc();
+  record.generation = -1;
+  record.reason = -1;
+  ThreadID tid = 0;
+  if (m_corProfilerInfo != nullptr && SUCCEEDED(m_corProfilerInfo->GetCurrentThreadID(&tid)) && tid != 0)
+  {
+    record.triggerThread = tid;
+    auto &bucket = m_threadBuckets[BucketIndex(tid)];
+    std::shared_lock bucketLock(bucket.mutex);
+    auto it = bucket.stacks.find(tid);
+    if (it != bucket.stacks.end() && it->second != nullptr)
+    {
+      std::lock_guard<std::mutex> guard(it->second->mutex);
+      const auto &frames = it->second->frames;
+      record.frameCount = static_cast<uint32_t>(std::min<size_t>(frames.size(), GcPauseRecord::kMaxFrames));
+      for (uint32_t i = 0; i < record.frameCount; i++)
+        record.frames[i] = frames[frames.size() - 1 - i].functionId;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(m_gcMutex);
+  m_pendingGc = record;
+  m_gcPending = true;
+}
+
+void StackManager::OnRuntimeSuspendAborted()
+{
+  std::lock_guard<std::mutex> guard(m_gcMutex);
+  m_gcPending = false;
+}
+
+void StackManager::OnGcStart(uint32_t gcIndex, uint32_t generation, uint32_t reason)
+{
+  std::lock_guard<std::mutex> guard(m_gcMutex);
+  if (!m_gcPending)
+    return;
+  m_pendingGc.gcIndex = gcIndex;
+  m_pendingGc.generation = static_cast<int32_t>(generation);
+  m_pendingGc.reason = static_cast<int32_t>(reason);
+}
+
+void StackManager::OnRuntimeResumeFinished()
+{
+  const uint64_t now = ReadTsc();
+  std::lock_guard<std::mutex> guard(m_gcMutex);
+  if (!m_gcPending || m_gcPauses == nullptr)
+    return;
+  m_gcPending = false;
+
+  GcPauseRecord &record = m_pendingGc;
+  record.resumeTsc = now;
+  if (!IsAttributableGcReason(record.reason))
+    record.frameCount = 0;
+  m_gcPauses->Push(record);
+
+  const uint64_t pause = now > record.suspendTsc ? now - record.suspendTsc : 0;
+  m_gcPauseCount++;
+  m_gcPauseTotalCycles += pause;
+  m_gcPauseMaxCycles = std::max(m_gcPauseMaxCycles, pause);
+  const uint64_t micros = TscToNanoseconds(pause) / 1000;
+  m_gcPauseHistogram[std::min<size_t>(std::bit_width(micros), kGcPauseHistogramBuckets - 1)]++;
+
+  if (record.frameCount != 0)
+  {
+    std::vector<FunctionID> stack(record.frames, record.frames + record.frameCount);
+    auto it = m_gcTriggerStacks.find(stack);
+    if (it == m_gcTriggerStacks.end() && m_gcTriggerStacks.size() < kMaxGcTriggerStacks)
+      it = m_gcTriggerStacks.emplace(std::move(stack), GcTriggerTotals{}).first;
+    if (it != m_gcTriggerStacks.end())
+    {
+      it->second.collections++;
+      it->second.pauseCycles += pause;
+    }
+  }
+}
+
+void StackManager::WriteGcPauses(std::ostream &out) const
+{
+  if (m_gcPauses == nullptr)
+    return;
+
+  std::lock_guard<std::mutex> guard(m_gcMutex);
+  out << "GC pauses: " << m_gcPauseCount << ", total (ns): " << TscToNanoseconds(m_gcPauseTotalCycles)
+      << ", max (ns): " << TscToNanoseconds(m_gcPauseMaxCycles) << '\n';
+  for (size_t i = 0; i < kGcPauseHistogramBuckets; i++)
+  {
+    if (m_gcPauseHistogram[i] != 0)
+      out << "    < " << (1ull << i) << " us: " << m_gcPauseHistogram[i] << '\n';
+  }
+
+  auto frameName = [&](FunctionID id) {
+    const FunctionInfo *info = FindFunctionInfo(id);
+    return info != nullptr ? info->methodSignature : std::string("<unknown>");
+  };
+
+  auto records = m_gcPauses->Snapshot(m_config.gcRecords);
+  out << "Recent GC pauses (oldest first):" << '\n';
+  if (records.empty())
+    out << "    (none)" << '\n';
+  const uint64_t now = ReadTsc();
+  for (const auto &record : records)
+  {
+    out << "    GC #" << record.gcIndex << " gen " << record.generation << " (" << GcReasonName(record.reason) << "), pause (ns): "
+        << TscToNanoseconds(record.resumeTsc - record.suspendTsc) << ", ended " << (now > record.resumeTsc ? TscToNanoseconds(now - record.resumeTsc) : 0)
+        << " ns ago, thread " << record.triggerThread << '\n';
+    if (record.frameCount != 0)
+      out << "        at " << frameName(record.frames[0]) << '\n';
+  }
+
+  std::vector<std::pair<const std::vector<FunctionID> *, GcTriggerTotals>> triggers;
+  for (const auto &kv : m_gcTriggerStacks)
+    triggers.emplace_back(&kv.first, kv.second);
+  std::sort(triggers.begin(), triggers.end(), [](const auto &a, const auto &b) {
+    return a.second.pauseCycles > b.second.pauseCycles;
+  });
+  triggers.resize(std::min<size_t>(triggers.size(), 10));
+  out << "Top 10 stacks triggering GCs (allocation or induced, by total pause):" << '\n';
+  if (triggers.empty())
+    out << "    (none)" << '\n';
+  for (const auto &kv : triggers)
+  {
+    out << "    " << kv.second.collections << " GC(s), pause (ns): " << TscToNanoseconds(kv.second.pauseCycles) << '\n';
+    for (FunctionID id : *kv.first)
+      out << "        " << frameName(id) << '\n';
+  }
+  out << '\n';
+}
+
+void StackManager::OnThreadAssignedToOSThread(ThreadID managedThreadId, DWORD osThreadId)
+{
+  auto &state = GetOrCreateThreadState(managedThreadId);
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.osThreadId = osThreadId;
+}
+
+void StackManager::OnThreadNameChanged(ThreadID threadId, const WCHAR *name, ULONG nameLength)
+{
+  if (name == nullptr)
+    nameLength = 0;
+  while (nameLength != 0 && name[nameLength - 1] == 0)
+    nameLength--;
+  const char *interned = nameLength != 0 ? m_internedNames.Intern(WStrToUtf8(std::basic_string<WCHAR>(name, nameLength))) : "";
+  auto &state = GetOrCreateThreadState(threadId);
+  std::lock_guard<std::mutex> guard(state.mutex);
+  state.name = interned;
+  BumpCounter(state.generation);
+}
+
+std::vector<StackManager::ThreadStackSnapshot> StackManager::SnapshotAllStacks() const
+{
+  std::vector<ThreadStackSnapshot> out;
+
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      const ThreadID tid = kv.first;
+      const ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+
+      ThreadStackSnapshot snap;
+      snap.threadId = tid;
+
+      {
+        std::lock_guard<std::mutex> guard(st->mutex);
+        snap.osThreadId = st->osThreadId;
+        snap.name = st->name;
+        snap.desyncNotFound = st->desyncNotFound;
+        snap.desyncFoundNotTop = st->desyncFoundNotTop;
+        snap.tailcallPops = st->tailcallPops;
+        snap.exceptionUnwindPops = st->exceptionUnwindPops;
+        snap.overflowDepth = st->overflowDepth;
+        snap.frames = st->frames;
+      }
+
+      out.push_back(std::move(snap));
+    }
+  }
+
+  return out;
+}
+
+void StackManager::AccumulateStats(const ThreadStackState &state, SW2TracerStats &out)
+{
+  const auto &c = state.counters;
+  out.enters += c.enters.load(std::memory_order_relaxed);
+  out.leaves += c.leaves.load(std::memory_order_relaxed);
+  out.tailcalls += c.tailcalls.load(std::memory_order_relaxed);
+  out.functionInfoCacheHits += c.functionInfoCacheHits.load(std::memory_order_relaxed);
+  out.functionInfoCacheMisses += c.functionInfoCacheMisses.load(std::memory_order_relaxed);
+  // Kept in cycles while accumulating, converted once in GetStats.
+  out.symbolizationNs += c.symbolizationCycles.load(std::memory_order_relaxed);
+  out.maxStackDepth = std::max<uint64_t>(out.maxStackDepth, c.maxStackDepth.load(std::memory_order_relaxed));
+  out.foldedEnters += c.foldedEnters.load(std::memory_order_relaxed);
+  out.depthCapDrops += c.depthCapDrops.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < kHookHistogramBuckets; i++)
+  {
+    out.enterCyclesHistogram[i] += c.enterCycles[i].load(std::memory_order_relaxed);
+    out.leaveCyclesHistogram[i] += c.leaveCycles[i].load(std::memory_order_relaxed);
+  }
+
+  std::lock_guard<std::mutex> guard(state.mutex);
+  out.desyncNotFound += state.desyncNotFound;
+  out.desyncFoundNotTop += state.desyncFoundNotTop;
+  out.exceptionUnwindPops += state.exceptionUnwindPops;
+}
+
+void StackManager::GetStats(SW2TracerStats &out) const
+{
+  SW2TracerStats stats{};
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    stats = m_retiredStats;
+  }
+
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      if (kv.second == nullptr)
+        continue;
+      AccumulateStats(*kv.second, stats);
+      stats.threadCount++;
+    }
+  }
+
+  stats.symbolizationNs = TscToNanoseconds(stats.symbolizationNs);
+  stats.methodTokenCacheHits = m_methodTokenCacheHits.load(std::memory_order_relaxed);
+  stats.methodTokenCacheMisses = m_methodTokenCacheMisses.load(std::memory_order_relaxed);
+  stats.hookSampleInterval = kHookSampleInterval;
+  stats.watchdogReports = m_watchdogReports.load(std::memory_order_relaxed);
+  stats.slowCalls = m_slowCalls != nullptr ? m_slowCalls->Total() : 0;
+  {
+    std::lock_guard<std::mutex> guard(m_allocationsMutex);
+    stats.allocationSamples = m_allocationTotals.samples;
+    stats.allocationSampledBytes = m_allocationTotals.bytes;
+  }
+  {
+    std::lock_guard<std::mutex> guard(m_gcMutex);
+    stats.gcPauses = m_gcPauseCount;
+    stats.gcPauseTotalNs = TscToNanoseconds(m_gcPauseTotalCycles);
+    stats.gcPauseMaxNs = TscToNanoseconds(m_gcPauseMaxCycles);
+    std::copy(std::begin(m_gcPauseHistogram), std::end(m_gcPauseHistogram), stats.gcPauseHistogram);
+  }
+
+  uint32_t size = std::min<uint32_t>(out.size, sizeof(SW2TracerStats));
+  stats.size = size;
+  std::memcpy(&out, &stats, size);
+}
+
+std::vector<std::pair<FunctionID, StackManager::FunctionProfile>> StackManager::CollectProfile() const
+{
+  std::unordered_map<FunctionID, FunctionProfile> merged;
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    merged = m_retiredProfile;
+  }
+
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      const ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+
+      std::lock_guard<std::mutex> guard(st->mutex);
+      for (const auto &entry : st->profile)
+        merged[entry.first].Merge(entry.second);
+    }
+  }
+
+  return {merged.begin(), merged.end()};
 }
 
-void StackManager::OnThreadDestroyed(ThreadID threadId)
+CallingContextTree StackManager::CollectCallingContextTree() const
 {
-  auto &bucket = m_threadBuckets[BucketIndex(threadId)];
-  std::unique_lock lock(bucket.mutex);
-  bucket.stacks.erase(threadId);
+  CallingContextTree merged(UINT32_MAX);
+  {
+    std::lock_guard<std::mutex> retiredGuard(m_retiredStatsMutex);
+    if (m_retiredCct != nullptr)
+      merged.Merge(*m_retiredCct);
+  }
+
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      const ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+
+      std::lock_guard<std::mutex> guard(st->mutex);
+      if (st->cct != nullptr)
+        merged.Merge(*st->cct);
+    }
+  }
+
+  return merged;
 }
 
-void StackManager::OnThreadAssignedToOSThread(ThreadID managedThreadId, DWORD osThreadId)
+void StackManager::DumpCollapsedStacks(std::string path, bool weightByTime) const
 {
-  auto &state = GetOrCreateThreadState(managedThreadId);
-  std::lock_guard<std::mutex> guard(state.mutex);
-  state.osThreadId = osThreadId;
+  SymbolReadScope symbols(*this);
+  std::ofstream outFile(path);
+  CallingContextTree tree = CollectCallingContextTree();
+  const auto &nodes = tree.Nodes();
+
+  std::unordered_map<FunctionID, std::string> names;
+  auto nameOf = [&](FunctionID id) -> const std::string & {
+    auto it = names.find(id);
+    if (it != names.end())
+      return it->second;
+    const FunctionInfo *info = FindFunctionInfo(id);
+    std::string name = info != nullptr ? info->methodSignature : "<unknown>";
+    std::replace(name.begin(), name.end(), ';', ',');
+    return names.emplace(id, std::move(name)).first->second;
+  };
+
+  // Flamegraph tools add a frame's children onto its own weight, so call counts are written as
+  // self counts: a node's calls minus those of its children. Parents precede their children.
+  std::vector<uint64_t> childCalls(nodes.size(), 0);
+  for (uint32_t i = 2; i < nodes.size(); i++)
+    childCalls[nodes[i].parent] += nodes[i].calls;
+
+  std::vector<uint32_t> contextPath;
+  for (uint32_t i = 1; i < nodes.size(); i++)
+  {
+    const auto &node = nodes[i];
+    const uint64_t selfCalls = node.calls > childCalls[i] ? node.calls - childCalls[i] : 0;
+    uint64_t weight = weightByTime ? TscToNanoseconds(node.exclusiveCycles) : selfCalls;
+    if (weight == 0)
+      continue;
+
+    if (i == CallingContextTree::kOverflow)
+    {
+      outFile << "[cct node budget exceeded] " << weight << '\n';
+      continue;
+    }
+
+    contextPath.clear();
+    for (uint32_t n = i; n != CallingContextTree::kRoot; n = nodes[n].parent)
+      contextPath.push_back(n);
+
+    for (size_t p = contextPath.size(); p-- > 0;)
+    {
+      outFile << nameOf(nodes[contextPath[p]].functionId);
+      if (p != 0)
+        outFile << ";";
+    }
+    outFile << " " << weight << '\n';
+  }
 }
 
-std::vector<StackManager::ThreadStackSnapshot> StackManager::SnapshotAllStacks() const
+void StackManager::WriteFlightEvents(std::ostream &out, const std::vector<FlightEvent> &events) const
 {
-  std::vector<ThreadStackSnapshot> out;
+  if (events.empty())
+    return;
+
+  const uint64_t newest = events.back().Tsc();
+  out << "    Recent events (oldest first):" << '\n';
+  for (const auto &event : events)
+  {
+    const FunctionInfo *info = FindFunctionInfo(event.functionId);
+    out << "        -" << TscToNanoseconds(newest - event.Tsc()) << "ns " << FlightEventKindName(event.Kind()) << " "
+        << (info != nullptr ? info->methodSignature : "<unknown>") << '\n';
+  }
+  out << '\n';
+}
+
+std::string StackManager::FormatReturnValue(const ReturnRecord &record) const
+{
+  const auto et = static_cast<CorElementType>(record.elementType);
+  if (record.isNull)
+    return PR_NULL_VALUE;
+
+  switch (et)
+  {
+  case ELEMENT_TYPE_STRING:
+  {
+    const WCHAR *chars = reinterpret_cast<const WCHAR *>(&record.value);
+    std::string text = "\"" + WStrToUtf8(std::basic_string<WCHAR>(chars, chars + std::min<uint32_t>(record.length, 4)));
+    if (record.length > 4)
+      return text + "...\" (length " + std::to_string(record.length) + ")";
+    return text + "\"";
+  }
+  case ELEMENT_TYPE_CLASS:
+  case ELEMENT_TYPE_OBJECT:
+  case ELEMENT_TYPE_SZARRAY:
+  case ELEMENT_TYPE_ARRAY:
+  {
+    std::string typeName = TryGetClassTypeName(m_corProfilerInfo, static_cast<ClassID>(record.value));
+    return typeName.empty() ? "<non-null>" : typeName;
+  }
+  case ELEMENT_TYPE_PTR:
+    return HexPtr(static_cast<UINT_PTR>(record.value));
+  default:
+    return ReadParamDynamic(m_corProfilerInfo, et, reinterpret_cast<UINT_PTR>(&record.value), 0);
+  }
+}
+
+void StackManager::WriteReturnValues(std::ostream &out, const std::vector<ReturnRecord> &records) const
+{
+  if (records.empty())
+    return;
+
+  const uint64_t newest = records.back().tsc;
+  out << "    Recent return values (oldest first):" << '\n';
+  for (const auto &record : records)
+  {
+    const FunctionInfo *info = FindFunctionInfo(record.functionId);
+    out << "        -" << TscToNanoseconds(newest - record.tsc) << "ns " << (info != nullptr ? info->methodSignature : "<unknown>")
+        << " => " << FormatReturnValue(record) << '\n';
+  }
+  out << '\n';
+}
+
+void StackManager::DumpTrace(std::string path, size_t maxEventsPerThread) const
+{
+  SymbolReadScope symbols(*this);
+
+  struct ThreadEvents
+  {
+    ThreadID threadId = 0;
+    DWORD osThreadId = 0;
+    const char *name = "";
+    std::vector<FlightEvent> events;
+  };
 
+  std::vector<ThreadEvents> threads;
+  uint64_t baseTsc = UINT64_MAX;
   for (const auto &bucket : m_threadBuckets)
   {
     std::shared_lock bucketLock(bucket.mutex);
     for (const auto &kv : bucket.stacks)
     {
-      const ThreadID tid = kv.first;
       const ThreadStackState *st = kv.second.get();
-      if (st == nullptr)
+      if (st == nullptr || st->flight == nullptr)
         continue;
 
-      ThreadStackSnapshot snap;
-      snap.threadId = tid;
-
+      ThreadEvents te;
+      te.threadId = kv.first;
       {
         std::lock_guard<std::mutex> guard(st->mutex);
-        snap.osThreadId = st->osThreadId;
-        snap.desyncNotFound = st->desyncNotFound;
-        snap.desyncFoundNotTop = st->desyncFoundNotTop;
-        snap.tailcallPops = st->tailcallPops;
-        snap.frames = st->frames;
+        te.osThreadId = st->osThreadId;
+        te.name = st->name;
       }
+      te.events = st->flight->Snapshot(maxEventsPerThread);
+      if (te.events.empty())
+        continue;
+      baseTsc = std::min(baseTsc, te.events.front().Tsc());
+      threads.push_back(std::move(te));
+    }
+  }
 
-      out.push_back(std::move(snap));
+  std::unordered_map<FunctionID, std::string> names;
+  auto nameOf = [&](FunctionID id) -> const std::string & {
+    auto it = names.find(id);
+    if (it != names.end())
+      return it->second;
+    const FunctionInfo *info = FindFunctionInfo(id);
+    return names.emplace(id, JsonEscape(info != nullptr ? info->methodSignature : "<unknown>")).first->second;
+  };
+
+  std::ofstream outFile(path);
+  outFile << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &te : threads)
+  {
+    const uint64_t tid = te.osThreadId != 0 ? te.osThreadId : static_cast<uint64_t>(te.threadId);
+    if (te.name[0] != '\0')
+    {
+      outFile << (first ? "\n" : ",\n");
+      first = false;
+      outFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << JsonEscape(te.name) << "\"}}";
+    }
+    for (const auto &event : te.events)
+    {
+      const char *phase = "i";
+      switch (event.Kind())
+      {
+      case FlightEventKind::Enter:
+        phase = "B";
+        break;
+      case FlightEventKind::Leave:
+      case FlightEventKind::Tailcall:
+      case FlightEventKind::Unwind:
+        phase = "E";
+        break;
+      default:
+        break;
+      }
+
+      double us = static_cast<double>(TscToNanoseconds(event.Tsc() - baseTsc)) / 1000.0;
+      outFile << (first ? "\n" : ",\n");
+      first = false;
+      outFile << "{\"name\":\"" << nameOf(event.functionId) << "\",\"cat\":\"" << FlightEventKindName(event.Kind())
+              << "\",\"ph\":\"" << phase << "\",\"ts\":" << std::fixed << us << ",\"pid\":1,\"tid\":" << tid;
+      if (phase[0] == 'i')
+        outFile << ",\"s\":\"t\"";
+      outFile << "}";
     }
   }
+  outFile << "\n]}" << '\n';
+}
 
-  return out;
+void StackManager::WriteThreadStack(std::ostream &out, ThreadID tid, DWORD osThreadId, const char *name, int64_t cpuNs, const std::vector<StackFrame> &frames, uint32_t overflowDepth, uint64_t now) const
+{
+  out << "Thread " << tid;
+  if (name != nullptr && name[0] != '\0')
+    out << " \"" << name << "\"";
+  if (osThreadId != 0)
+  {
+    out << " (OS thread " << osThreadId;
+    if (cpuNs >= 0)
+      out << ", CPU " << cpuNs / 1000000 << " ms";
+    out << ")";
+  }
+  out << ":" << '\n';
+  if (overflowDepth > 0)
+  {
+    out << "    (" << overflowDepth << " deeper frame(s) not recorded: SW2TRACER_MAX_DEPTH reached)" << '\n';
+    out << '\n';
+  }
+
+  // Top first, in the representation SW2TracerGetStack returns: direct recursion folded into
+  // one frame printed as "xN", mutual recursion unfolded.
+  for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+  {
+    const StackFrame &frame = *it;
+    out << "    " << frame.functionInfo->methodSignature;
+    if (frame.repeat > 0)
+      out << " x" << (frame.repeat + 1);
+    out << '\n';
+    for (const auto &arg : frame.argumentInfo)
+    {
+      out << "    " << arg << '\n';
+    }
+    out << "        Assembly: " << frame.functionInfo->assemblyName << '\n';
+    out << "        Module  : " << frame.functionInfo->moduleName << '\n';
+    if (frame.enterTimestamp != 0 && now > frame.enterTimestamp)
+    {
+      out << "        Active (ns): " << TscToNanoseconds(now - frame.enterTimestamp) << '\n';
+    }
+    out << '\n';
+  }
+  if (frames.size() == 0)
+  {
+    out << "    No frames" << '\n';
+    out << '\n';
+  }
 }
 
 void StackManager::Dump(std::string path) const
 {
   std::ofstream outFile(path);
+  WriteDump(outFile);
+}
+
+void StackManager::WriteDump(std::ostream &outFile) const
+{
+  SymbolReadScope symbols(*this);
+  const auto dumpTimestamp = ReadTsc();
+  if (GetMode() == TracerMode::Off)
+  {
+    outFile << "Tracing is off; stacks below may be stale." << '\n';
+    outFile << '\n';
+  }
+
+  // Busiest threads first. Everything a thread section needs is copied in one pass, the frames
+  // under the thread's own lock as in WriteCheckpoint, so the hooks can keep mutating them while
+  // CPU times are read, the threads sorted and the sections formatted.
+  struct DumpedThread
+  {
+    ThreadID threadId;
+    DWORD osThreadId;
+    const char *name;
+    int64_t cpuNs;
+    uint32_t overflowDepth;
+    std::vector<StackFrame> frames;
+    std::vector<FlightEvent> events;
+    std::vector<ReturnRecord> returns;
+  };
+  std::vector<DumpedThread> threads;
   for (const auto &bucket : m_threadBuckets)
   {
     std::shared_lock bucketLock(bucket.mutex);
     for (const auto &kv : bucket.stacks)
     {
-      const ThreadID tid = kv.first;
       const ThreadStackState *st = kv.second.get();
       if (st == nullptr)
         continue;
-      outFile << "Thread " << tid << ":" << std::endl;
-      for (auto it = st->frames.rbegin(); it != st->frames.rend(); ++it)
+      DumpedThread thread{kv.first, 0, "", -1, 0, {}, {}, {}};
       {
-        const auto &frame = *it;
+        std::lock_guard<std::mutex> guard(st->mutex);
+        thread.osThreadId = st->osThreadId;
+        thread.name = st->name;
+        thread.overflowDepth = st->overflowDepth;
+        thread.frames = st->frames;
+      }
+      if (st->flight != nullptr)
+        thread.events = st->flight->Snapshot(m_config.flightRecorderDumpEvents);
+      if (st->returns != nullptr)
+        thread.returns = st->returns->Snapshot(m_config.returnRecords);
+      threads.push_back(std::move(thread));
+    }
+  }
+  for (auto &thread : threads)
+    thread.cpuNs = ThreadCpuNanoseconds(thread.osThreadId);
+  std::sort(threads.begin(), threads.end(), [](const DumpedThread &a, const DumpedThread &b) {
+    return a.cpuNs != b.cpuNs ? a.cpuNs > b.cpuNs : a.threadId < b.threadId;
+  });
+
+  for (const auto &thread : threads)
+  {
+    WriteThreadStack(outFile, thread.threadId, thread.osThreadId, thread.name, thread.cpuNs, thread.frames, thread.overflowDepth, dumpTimestamp);
+    WriteFlightEvents(outFile, thread.events);
+    WriteReturnValues(outFile, thread.returns);
+  }
+
+  auto profile = CollectProfile();
+  if (!profile.empty())
+  {
+    std::sort(profile.begin(), profile.end(), [](const auto &a, const auto &b) {
+      return a.second.exclusiveCycles > b.second.exclusiveCycles;
+    });
+    profile.resize(std::min<size_t>(profile.size(), 50));
+
+    outFile << "Top 50 functions by exclusive time (timing mode):" << '\n';
+    for (const auto &kv : profile)
+    {
+      const auto &entry = kv.second;
+      const FunctionInfo *info = FindFunctionInfo(kv.first);
 
-        outFile << "    " << frame.functionInfo->methodSignature << std::endl;
-        for (const auto &arg : frame.argumentInfo)
+      // Upper bound of the bucket holding the 99th percentile call.
+      uint64_t p99Cycles = 0;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < kProfileHistogramBuckets; i++)
+      {
+        seen += entry.histogram[i];
+        if (seen * 100 >= entry.calls * 99)
         {
-          outFile << "    " << arg << std::endl;
+          p99Cycles = i == 0 ? 0 : (1ull << i) - 1;
+          break;
         }
-        outFile << "        Assembly: " << frame.functionInfo->assemblyName << std::endl;
-        outFile << "        Module  : " << frame.functionInfo->moduleName << std::endl;
-        outFile << std::endl;
       }
-      if (st->frames.size() == 0)
+
+      outFile << "    " << (info != nullptr ? info->methodSignature : "<unknown>") << '\n';
+      if (info != nullptr)
+        outFile << "        Assembly: " << info->assemblyName << '\n';
+      outFile << "        Calls: " << entry.calls
+              << ", Inclusive (ns): " << TscToNanoseconds(entry.inclusiveCycles)
+              << ", Exclusive (ns): " << TscToNanoseconds(entry.exclusiveCycles)
+              << ", Avg (ns): " << (entry.calls ? TscToNanoseconds(entry.inclusiveCycles / entry.calls) : 0)
+              << ", p99 (ns) <= " << TscToNanoseconds(p99Cycles) << '\n';
+      outFile << '\n';
+    }
+  }
+
+  // outFile may be a caller's sink (a callback, a blocking pipe), so no tracer lock is held while
+  // writing to it: sections that format under a lock are rendered into memory first.
+  auto writeUnlocked = [&outFile](auto &&write) {
+    std::ostringstream section;
+    write(section);
+    outFile << section.view();
+  };
+  WriteAssemblyTime(outFile);
+  WriteSlowCalls(outFile);
+  writeUnlocked([this](std::ostream &out) { WriteAllocations(out); });
+  writeUnlocked([this](std::ostream &out) { WriteGcPauses(out); });
+
+  std::vector<std::pair<FunctionID, TransitionRecord>> sortedTransitions;
+  {
+    std::shared_lock lock(m_unmanagedToManagedTransitionsMutex);
+    sortedTransitions.assign(m_unmanagedToManagedTransitions.begin(), m_unmanagedToManagedTransitions.end());
+  }
+  outFile << "Recent 50 unmanaged to managed transitions (last seen):" << '\n';
+  auto now = std::chrono::steady_clock::now();
+  if (sortedTransitions.empty())
+  {
+    outFile << "    (none)" << '\n';
+  }
+  else
+  {
+    std::sort(sortedTransitions.begin(), sortedTransitions.end(), [](const auto &a, const auto &b) {
+      return a.second.lastTimestamp > b.second.lastTimestamp;
+    });
+    sortedTransitions.resize(std::min<size_t>(sortedTransitions.size(), 50));
+    for (const auto &kv : sortedTransitions)
+    {
+      const auto &record = kv.second;
+      if (record.functionInfo == nullptr || record.lastTimestamp.time_since_epoch().count() == 0)
+        continue;
+
+      auto age = std::chrono::duration_cast<std::chrono::nanoseconds>(now - record.lastTimestamp).count();
+      outFile << "    " << record.functionInfo->methodSignature << '\n';
+      outFile << "        Assembly: " << record.functionInfo->assemblyName << '\n';
+      outFile << "        Module  : " << record.functionInfo->moduleName << '\n';
+      outFile << "        Age (ns): " << age << '\n';
+      outFile << '\n';
+    }
+  }
+}
+
+StackManager::~StackManager()
+{
+  StopWatchdog();
+  StopCheckpoints();
+}
+
+void StackManager::StartCheckpoints()
+{
+  if (m_config.checkpointIntervalMs == 0 || m_checkpointThread.joinable())
+    return;
+
+  std::error_code ec;
+  std::filesystem::create_directories(m_config.checkpointDir, ec);
+  if (ec)
+  {
+    LOG("ERROR: cannot create checkpoint directory '%s': %s", m_config.checkpointDir.c_str(), ec.message().c_str());
+    return;
+  }
+
+  m_checkpointStop = false;
+  try
+  {
+    m_checkpointThread = std::thread([this]() {
+      const auto interval = std::chrono::milliseconds(m_config.checkpointIntervalMs);
+      std::unique_lock lock(m_checkpointMutex);
+      while (!m_checkpointWake.wait_for(lock, interval, [this]() { return m_checkpointStop; }))
+      {
+        lock.unlock();
+        WriteCheckpoint();
+        lock.lock();
+      }
+    });
+  }
+  catch (const std::system_error &)
+  {
+    LOG("ERROR: cannot start the checkpoint thread");
+    return;
+  }
+  LOG("Checkpointing changed stacks every %u ms to '%s'", m_config.checkpointIntervalMs, m_config.checkpointDir.c_str());
+}
+
+void StackManager::StopCheckpoints()
+{
+  if (!m_checkpointThread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(m_checkpointMutex);
+    m_checkpointStop = true;
+  }
+  m_checkpointWake.notify_all();
+  m_checkpointThread.join();
+}
+
+size_t StackManager::WriteCheckpoint()
+{
+  namespace fs = std::filesystem;
+
+  struct ThreadCheckpoint
+  {
+    ThreadID threadId = 0;
+    DWORD osThreadId = 0;
+    const char *name = "";
+    uint64_t generation = 0;
+    uint32_t overflowDepth = 0;
+    std::vector<StackFrame> frames;
+    std::vector<FlightEvent> events;
+    std::vector<ReturnRecord> returns;
+  };
+
+  std::lock_guard<std::mutex> writeGuard(m_checkpointWriteMutex);
+  SymbolReadScope symbols(*this);
+  const uint64_t now = ReadTsc();
+
+  // Copy what changed under the locks, then do the I/O without holding any of them.
+  std::unordered_map<ThreadID, uint64_t> live;
+  std::vector<ThreadCheckpoint> changed;
+  for (const auto &bucket : m_threadBuckets)
+  {
+    std::shared_lock bucketLock(bucket.mutex);
+    for (const auto &kv : bucket.stacks)
+    {
+      const ThreadStackState *st = kv.second.get();
+      if (st == nullptr)
+        continue;
+      const uint64_t generation = st->generation.load(std::memory_order_relaxed);
+      live.emplace(kv.first, generation);
+      auto last = m_checkpointGenerations.find(kv.first);
+      if (last != m_checkpointGenerations.end() && last->second == generation)
+        continue;
+
+      ThreadCheckpoint cp;
+      cp.threadId = kv.first;
       {
-        outFile << "    No frames" << std::endl;
-        outFile << std::endl;
+        std::lock_guard<std::mutex> guard(st->mutex);
+        cp.osThreadId = st->osThreadId;
+        cp.name = st->name;
+        cp.generation = st->generation.load(std::memory_order_relaxed);
+        cp.overflowDepth = st->overflowDepth;
+        cp.frames = st->frames;
       }
+      live[kv.first] = cp.generation;
+      if (st->flight != nullptr)
+        cp.events = st->flight->Snapshot(m_config.flightRecorderDumpEvents);
+      if (st->returns != nullptr)
+        cp.returns = st->returns->Snapshot(m_config.returnRecords);
+      changed.push_back(std::move(cp));
     }
   }
 
-  outFile << "Recent 50 unmanaged to managed transitions (last seen):" << std::endl;
-  auto now = std::chrono::steady_clock::now();
+  const fs::path dir(m_config.checkpointDir);
+  auto threadFile = [&](ThreadID tid) { return dir / ("thread-" + std::to_string(tid) + ".txt"); };
+  // Readers only ever see a complete old or new file: rename replaces the target atomically.
+  auto writeAtomically = [&](const fs::path &target, auto &&write) {
+    fs::path temp = target;
+    temp += ".tmp";
+    {
+      std::ofstream out(temp, std::ios::trunc);
+      if (!out)
+        return false;
+      write(out);
+      out.flush();
+      if (!out)
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(temp, target, ec);
+    return !ec;
+  };
+
+  size_t written = 0;
+  for (const auto &cp : changed)
   {
-    std::shared_lock lock(m_unmanagedToManagedTransitionsMutex);
-    if (m_unmanagedToManagedTransitions.empty())
+    bool ok = writeAtomically(threadFile(cp.threadId), [&](std::ostream &out) {
+      // CPU time is as of this write; the file is only rewritten when the stack changes.
+      out << "Checkpoint generation " << cp.generation << '\n';
+      WriteThreadStack(out, cp.threadId, cp.osThreadId, cp.name, ThreadCpuNanoseconds(cp.osThreadId), cp.frames, cp.overflowDepth, now);
+      WriteFlightEvents(out, cp.events);
+      WriteReturnValues(out, cp.returns);
+    });
+    if (ok)
     {
-      outFile << "    (none)" << std::endl;
+      written++;
+      continue;
     }
+    // Retried next pass. A thread that already has a file keeps it, listed at the generation it
+    // holds, rather than dropping out of live and having its last good checkpoint removed below.
+    auto last = m_checkpointGenerations.find(cp.threadId);
+    if (last != m_checkpointGenerations.end())
+      live[cp.threadId] = last->second;
     else
+      live.erase(cp.threadId);
+  }
+
+  size_t removed = 0;
+  for (const auto &kv : m_checkpointGenerations)
+  {
+    if (live.count(kv.first) == 0)
+    {
+      std::error_code ec;
+      fs::remove(threadFile(kv.first), ec);
+      removed++;
+    }
+  }
+  m_checkpointGenerations = std::move(live);
+
+  if (written != 0 || removed != 0)
+  {
+    writeAtomically(dir / "threads.txt", [&](std::ostream &out) {
+      for (const auto &kv : m_checkpointGenerations)
+        out << "thread-" << kv.first << ".txt generation " << kv.second << '\n';
+    });
+  }
+  return written;
+}
+
+bool StackManager::WatchCurrentThread(uint32_t thresholdMs)
+{
+  ThreadID tid = 0;
+  if (m_corProfilerInfo == nullptr || FAILED(m_corProfilerInfo->GetCurrentThreadID(&tid)) || tid == 0)
+    return false;
+
+  std::lock_guard<std::mutex> guard(m_watchdogMutex);
+  if (thresholdMs == 0)
+  {
+    m_watchedThreads.erase(tid);
+    return true;
+  }
+
+  WatchedThread &watched = m_watchedThreads[tid];
+  watched = WatchedThread{};
+  watched.thresholdMs = thresholdMs;
+  watched.lastProgress = std::chrono::steady_clock::now();
+  {
+    auto &state = GetOrCreateThreadState(tid);
+    std::lock_guard<std::mutex> stateGuard(state.mutex);
+    watched.baseDepth = state.frames.size();
+    watched.generation = state.generation.load(std::memory_order_relaxed);
+  }
+
+  if (!m_watchdogThread.joinable())
+  {
+    m_watchdogStop = false;
+    try
     {
-      std::vector<std::pair<FunctionID, TransitionRecord>> sortedTransitions(m_unmanagedToManagedTransitions.begin(), m_unmanagedToManagedTransitions.end());
-      std::sort(sortedTransitions.begin(), sortedTransitions.end(), [](const auto &a, const auto &b) {
-        return a.second.lastTimestamp > b.second.lastTimestamp;
+      m_watchdogThread = std::thread([this]() {
+        const auto interval = std::chrono::milliseconds(std::max<uint32_t>(m_config.watchdogPollMs, 1));
+        std::unique_lock lock(m_watchdogMutex);
+        while (!m_watchdogWake.wait_for(lock, interval, [this]() { return m_watchdogStop; }))
+        {
+          lock.unlock();
+          PollWatchedThreads();
+          lock.lock();
+        }
       });
-      sortedTransitions.resize(std::min<size_t>(sortedTransitions.size(), 50));
-      for (const auto &kv : sortedTransitions)
+    }
+    catch (const std::system_error &)
+    {
+      LOG("ERROR: cannot start the watchdog thread");
+      m_watchedThreads.erase(tid);
+      return false;
+    }
+  }
+  LOG("Watchdog: watching thread %llu (threshold %u ms, calls from depth %zu)", (unsigned long long)tid, thresholdMs, watched.baseDepth);
+  return true;
+}
+
+void StackManager::StopWatchdog()
+{
+  if (!m_watchdogThread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> guard(m_watchdogMutex);
+    m_watchdogStop = true;
+  }
+  m_watchdogWake.notify_all();
+  m_watchdogThread.join();
+}
+
+void StackManager::PollWatchedThreads()
+{
+  struct HangReport
+  {
+    ThreadID threadId = 0;
+    std::string reason;
+    std::vector<StackFrame> frames;
+    std::vector<uint64_t> activeMs;
+  };
+
+  SymbolReadScope symbols(*this);
+  std::vector<HangReport> reports;
+  {
+    std::lock_guard<std::mutex> guard(m_watchdogMutex);
+    const auto now = std::chrono::steady_clock::now();
+    auto msSince = [&](std::chrono::steady_clock::time_point t) {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - t).count());
+    };
+
+    for (auto it = m_watchedThreads.begin(); it != m_watchedThreads.end();)
+    {
+      const ThreadID tid = it->first;
+      WatchedThread &watched = it->second;
+      auto &bucket = m_threadBuckets[BucketIndex(tid)];
+      std::shared_lock bucketLock(bucket.mutex);
+      auto found = bucket.stacks.find(tid);
+      if (found == bucket.stacks.end() || found->second == nullptr)
+      {
+        it = m_watchedThreads.erase(it); // thread destroyed
+        continue;
+      }
+
+      ThreadStackState &state = *found->second;
+      std::lock_guard<std::mutex> stateGuard(state.mutex);
+      const uint64_t generation = state.generation.load(std::memory_order_relaxed);
+      if (generation != watched.generation)
+      {
+        watched.generation = generation;
+        watched.lastProgress = now;
+      }
+
+      // Frames below the first changed index are the same activations as on the last poll.
+      const auto &frames = state.frames;
+      size_t same = 0;
+      while (same < frames.size() && same < watched.frameSeen.size() && watched.frameSeen[same].first == frames[same].enterGeneration)
+        same++;
+      watched.frameSeen.resize(same);
+      for (size_t i = same; i < frames.size(); i++)
+        watched.frameSeen.emplace_back(frames[i].enterGeneration, now);
+
+      std::string reason;
+      const uint64_t stalledMs = msSince(watched.lastProgress);
+      if (stalledMs >= watched.thresholdMs)
+      {
+        reason = "made no progress for " + std::to_string(stalledMs) + " ms";
+      }
+      else if (frames.size() > watched.baseDepth)
+      {
+        const uint64_t activeMs = msSince(watched.frameSeen[watched.baseDepth].second);
+        if (activeMs >= watched.thresholdMs)
+          reason = "has been in " + frames[watched.baseDepth].functionInfo->methodSignature + " for " + std::to_string(activeMs) + " ms";
+      }
+
+      if (reason.empty())
+      {
+        watched.reported = false;
+      }
+      else if (!watched.reported)
       {
-        const auto &record = kv.second;
-        if (record.functionInfo == nullptr || record.lastTimestamp.time_since_epoch().count() == 0)
-          continue;
-
-        auto age = std::chrono::duration_cast<std::chrono::nanoseconds>(now - record.lastTimestamp).count();
-        outFile << "    " << record.functionInfo->methodSignature << std::endl;
-        outFile << "        Assembly: " << record.functionInfo->assemblyName << std::endl;
-        outFile << "        Module  : " << record.functionInfo->moduleName << std::endl;
-        outFile << "        Age (ns): " << age << std::endl;
-        outFile << std::endl;
+        // One report per stall; the thread has to recover before it can trigger another.
+        watched.reported = true;
+        HangReport report;
+        report.threadId = tid;
+        report.reason = reason + " (threshold " + std::to_string(watched.thresholdMs) + " ms)";
+        report.frames = frames;
+        for (const auto &seen : watched.frameSeen)
+          report.activeMs.push_back(msSince(seen.second));
+        reports.push_back(std::move(report));
       }
+      ++it;
+    }
+  }
+
+  // Written without the watchdog lock so WatchCurrentThread never waits on file I/O.
+  for (const auto &report : reports)
+  {
+    const uint64_t n = m_watchdogReports.fetch_add(1, std::memory_order_relaxed);
+    const std::string path = m_config.watchdogReportPrefix + "-" + std::to_string(report.threadId) + "-" + std::to_string(n) + ".txt";
+    std::ofstream out(path);
+    out << "Watchdog: thread " << report.threadId << " " << report.reason << '\n';
+    out << '\n';
+    out << "Frames of the watched thread, top first, with time active (to within " << m_config.watchdogPollMs << " ms):" << '\n';
+    for (size_t i = report.frames.size(); i-- > 0;)
+    {
+      const StackFrame &frame = report.frames[i];
+      out << "    " << frame.functionInfo->methodSignature;
+      if (frame.repeat > 0)
+        out << " x" << (frame.repeat + 1);
+      out << '\n';
+      out << "        Assembly: " << frame.functionInfo->assemblyName << '\n';
+      out << "        Active (ms): " << report.activeMs[i] << '\n';
     }
+    out << '\n';
+    WriteDump(out);
+    LOG("WARNING: watchdog: thread %llu %s; wrote %s", (unsigned long long)report.threadId, report.reason.c_str(), path.c_str());
   }
 }
 
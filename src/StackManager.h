@@ -4,26 +4,150 @@
 #include "specstrings_undef.h"
 #endif
 
+#include "CallingContextTree.h"
+#include "Config.h"
+#include "FlightRecorder.h"
+#include "Helper.h"
 #include "Logger.h"
+#include "SlowCallLog.h"
+#include "StringInterner.h"
+#include "ThreadCpu.h"
+#include "Tsc.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <array>
 #include <chrono>
+#include <cstdint>
 #include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "cor.h"
 #include "corprof.h"
 
 
+enum class TracerMode : uint32_t
+{
+  Off = 0,
+  Stacks = 1,
+  StacksArgs = 2,
+  Timing = 3,
+};
+
+// Checked at the top of the ELT stubs, so keep it a plain global instead of a StackManager member.
+inline std::atomic<uint32_t> g_TracerMode{static_cast<uint32_t>(TracerMode::Stacks)};
+
+inline bool IsTracingEnabled()
+{
+  return g_TracerMode.load(std::memory_order_relaxed) != static_cast<uint32_t>(TracerMode::Off);
+}
+
+// Filled by SW2TracerGetStats. The caller sets `size` to sizeof(SW2TracerStats) it was built with;
+// only that many bytes are written, so fields must only ever be appended.
+static constexpr uint32_t kHookHistogramBuckets = 32;
+static constexpr uint32_t kGcPauseHistogramBuckets = 24;
+
+struct SW2TracerStats
+{
+  uint32_t size;
+  uint32_t threadCount;
+  uint64_t enters;
+  uint64_t leaves;
+  uint64_t tailcalls;
+  uint64_t functionInfoCacheHits;
+  uint64_t functionInfoCacheMisses;
+  uint64_t symbolizationNs;
+  uint64_t maxStackDepth;
+  uint64_t desyncNotFound;
+  uint64_t desyncFoundNotTop;
+  uint64_t hookSampleInterval;
+  // Bucket i counts sampled hook calls that took [2^(i-1), 2^i) TSC cycles.
+  uint64_t enterCyclesHistogram[kHookHistogramBuckets];
+  uint64_t leaveCyclesHistogram[kHookHistogramBuckets];
+  uint64_t exceptionUnwindPops;
+  // Enters folded into a recursing top frame, and enters not recorded because of the depth cap.
+  uint64_t foldedEnters;
+  uint64_t depthCapDrops;
+  // Function info builds that found the method's token-level metadata already parsed, and those
+  // that had to parse it.
+  uint64_t methodTokenCacheHits;
+  uint64_t methodTokenCacheMisses;
+  // Hang reports written by the watchdog.
+  uint64_t watchdogReports;
+  // Calls logged as slow (SW2TRACER_SLOW_CALL_US), including those since overwritten.
+  uint64_t slowCalls;
+  // AllocationTick samples charged to shadow stacks (SW2TRACER_ALLOC) and the bytes they stand for.
+  uint64_t allocationSamples;
+  uint64_t allocationSampledBytes;
+  // GC pauses (SW2TRACER_GC): runtime suspend start to resume end. Bucket i of the histogram
+  // counts pauses that took [2^(i-1), 2^i) microseconds.
+  uint64_t gcPauses;
+  uint64_t gcPauseTotalNs;
+  uint64_t gcPauseMaxNs;
+  uint64_t gcPauseHistogram[kGcPauseHistogramBuckets];
+};
+
+// Filled by SW2TracerGetAssemblyTime (SW2TRACER_ASSEMBLY_TIME): exclusive time of completed calls
+// charged to the assembly owning each frame. Names longer than the buffer are truncated.
+struct SW2TracerAssemblyTime
+{
+  char assemblyName[128];
+  uint64_t exclusiveNs;
+  uint64_t calls;
+};
+
+// Filled by SW2TracerGetSlowCalls. functionIds[0] is the slow method, followed by its callers;
+// depth is the full stack depth, which may exceed frameCount.
+struct SW2TracerSlowCall
+{
+  uint64_t threadId;
+  uint64_t durationNs;
+  // Time since the call returned.
+  uint64_t ageNs;
+  uint32_t depth;
+  uint32_t frameCount;
+  uint64_t functionIds[SlowCallRecord::kMaxFrames];
+};
+
+// Filled by SW2TracerGetStack and SW2TracerLookupFunction. The names are interned: they stay
+// valid for the life of the process, also after the method's module is unloaded.
+struct SW2TracerFrame
+{
+  uint64_t functionId;
+  const char *assemblyName;
+  const char *typeName;
+  const char *methodSignature;
+  // Further activations of the same method folded into this frame (direct recursion).
+  uint32_t repeat;
+  uint32_t reserved;
+};
+
 struct FunctionInfo
 {
+  ModuleID moduleId = 0;
+  // Interned assemblyName; 0 is "<unknown>".
+  uint32_t assemblyIndex = 0;
   std::string moduleName;
   std::string assemblyName;
   std::string typeName;
   std::string methodSignature;
+  // Return type as read by the leave hook; ELEMENT_TYPE_END unless SW2TRACER_RETVAL is on, the
+  // method matches the filter and its return type is one we can decode.
+  CorElementType returnType = ELEMENT_TYPE_END;
+  // Calls lasting more cycles than this are logged as slow; UINT64_MAX when the method is not
+  // selected, so the leave hook needs no separate enabled check.
+  uint64_t slowCallCycles = UINT64_MAX;
+  // Interned copies of the names above, handed out by SW2TracerGetStack.
+  const char *internedAssemblyName = "";
+  const char *internedTypeName = "";
+  const char *internedMethodSignature = "";
   void DebugPrint() const
   {
     printf("\n");
@@ -40,6 +164,19 @@ struct StackFrame
   FunctionID functionId;
   const FunctionInfo* functionInfo = nullptr;
   std::vector<std::string> argumentInfo;
+  // Stack pointer at the ELT call (see asmhelpers); 0 when the caller did not supply one.
+  UINT_PTR stackPointer = 0;
+  uint64_t enterTimestamp = 0;
+  uint64_t childCycles = 0;
+  uint32_t cctNode = CallingContextTree::kRoot;
+  // Further activations of the same function folded into this frame (direct recursion), and
+  // how many consecutive frames of this function end here, counting this one.
+  uint32_t repeat = 0;
+  uint32_t run = 1;
+  // Thread generation right after this frame was entered; identifies the activation for the watchdog.
+  uint64_t enterGeneration = 0;
+  // Copied from the FunctionInfo at entry, so the charge survives the info being evicted.
+  uint32_t assemblyIndex = 0;
   
   void DebugPrint()
   {
@@ -61,7 +198,53 @@ class StackManager
 private:
   std::unordered_map<FunctionID, std::unique_ptr<FunctionInfo>> m_functionInfos;
   mutable std::shared_mutex m_functionInfosMutex;
+
+  // Second level under m_functionInfos: what every instantiation of a method, and every function
+  // of a module, has in common. Entries are never moved, so pointers stay valid.
+  struct MethodTokenKey
+  {
+    ModuleID moduleId;
+    mdMethodDef token;
+    bool operator==(const MethodTokenKey &other) const { return moduleId == other.moduleId && token == other.token; }
+  };
+  struct MethodTokenKeyHash
+  {
+    size_t operator()(const MethodTokenKey &key) const { return std::hash<uint64_t>{}(static_cast<uint64_t>(key.moduleId) * 0x9E3779B97F4A7C15ull ^ key.token); }
+  };
+  struct ModuleNames
+  {
+    std::string moduleName;
+    std::string assemblyName;
+    uint32_t assemblyIndex = 0;
+  };
+  std::unordered_map<MethodTokenKey, std::unique_ptr<MethodTokenInfo>, MethodTokenKeyHash> m_methodTokens;
+  std::unordered_map<ModuleID, std::unique_ptr<ModuleNames>> m_moduleNames;
+  mutable std::shared_mutex m_symbolCacheMutex;
+  // Assembly names by index, never removed: a reloaded plugin keeps its index and its totals.
+  // Guarded by m_symbolCacheMutex.
+  std::vector<std::string> m_assemblyNames{"<unknown>"};
+  std::unordered_map<std::string, uint32_t> m_assemblyIndexes;
+  std::atomic<uint64_t> m_methodTokenCacheHits{0};
+  std::atomic<uint64_t> m_methodTokenCacheMisses{0};
+
+  // Symbol data evicted on unload. Dumps read FunctionInfo pointers without the cache locks, so
+  // evicted entries are parked here and freed only once no SymbolReadScope is open.
+  struct RetiredSymbols
+  {
+    std::vector<std::unique_ptr<FunctionInfo>> functions;
+    std::vector<std::unique_ptr<MethodTokenInfo>> methodTokens;
+    std::vector<std::unique_ptr<ModuleNames>> modules;
+  };
+  mutable RetiredSymbols m_retiredSymbols;
+  mutable std::mutex m_retiredSymbolsMutex;
+  mutable std::atomic<uint32_t> m_symbolReaders{0};
+  // Modules between ModuleUnloadStarted and ModuleUnloadFinished. A symbol build that finishes
+  // after its module was evicted must not put entries back into the caches. Leaf lock: taken
+  // under the cache locks, never the other way round.
+  std::unordered_set<ModuleID> m_unloadingModules;
+  mutable std::mutex m_unloadingModulesMutex;
   ICorProfilerInfo15 *m_corProfilerInfo;
+  TracerConfig m_config;
   struct TransitionRecord
   {
     const FunctionInfo *functionInfo = nullptr;
@@ -70,14 +253,77 @@ private:
   std::unordered_map<FunctionID, TransitionRecord> m_unmanagedToManagedTransitions;
   mutable std::shared_mutex m_unmanagedToManagedTransitionsMutex;
 
+  static constexpr size_t kProfileHistogramBuckets = 40;
+
+  struct FunctionProfile
+  {
+    uint64_t calls = 0;
+    uint64_t inclusiveCycles = 0;
+    uint64_t exclusiveCycles = 0;
+    // Bucket i counts calls whose inclusive time was [2^(i-1), 2^i) TSC cycles.
+    std::array<uint64_t, kProfileHistogramBuckets> histogram{};
+
+    void Merge(const FunctionProfile &other)
+    {
+      calls += other.calls;
+      inclusiveCycles += other.inclusiveCycles;
+      exclusiveCycles += other.exclusiveCycles;
+      for (size_t i = 0; i < kProfileHistogramBuckets; i++)
+        histogram[i] += other.histogram[i];
+    }
+  };
+
+  using HookHistogram = std::array<std::atomic<uint64_t>, kHookHistogramBuckets>;
+
+  // Written only by the owning thread (load + store, no RMW) and read relaxed by GetStats,
+  // so it lives on its own cache lines to keep readers from bouncing the hook path.
+  struct alignas(64) HookCounters
+  {
+    std::atomic<uint64_t> enters{0};
+    std::atomic<uint64_t> leaves{0};
+    std::atomic<uint64_t> tailcalls{0};
+    std::atomic<uint64_t> functionInfoCacheHits{0};
+    std::atomic<uint64_t> functionInfoCacheMisses{0};
+    std::atomic<uint64_t> symbolizationCycles{0};
+    std::atomic<uint64_t> maxStackDepth{0};
+    std::atomic<uint64_t> foldedEnters{0};
+    std::atomic<uint64_t> depthCapDrops{0};
+    HookHistogram enterCycles{};
+    HookHistogram leaveCycles{};
+  };
+
+  struct AssemblyTime
+  {
+    uint64_t exclusiveCycles = 0;
+    uint64_t calls = 0;
+  };
+
   struct ThreadStackState
   {
     mutable std::mutex mutex;
+    ThreadID threadId = 0;
     std::vector<StackFrame> frames;
     uint32_t desyncNotFound = 0;
     uint32_t desyncFoundNotTop = 0;
     uint32_t tailcallPops = 0;
+    uint32_t exceptionUnwindPops = 0;
+    // Activations currently above the depth cap: entered but never pushed.
+    uint32_t overflowDepth = 0;
+    // Bumped under the mutex on every stack change; checkpoints skip threads where it is unchanged.
+    std::atomic<uint64_t> generation{0};
+    // Frames between ExceptionUnwindFunctionEnter and Leave, innermost last. More than one when a
+    // finally or filter running during the unwind throws and catches its own exception.
+    std::vector<FunctionID> unwindingFunctionIds;
     DWORD osThreadId = 0;
+    // Interned; set from ThreadNameChanged.
+    const char *name = "";
+    HookCounters counters;
+    std::unordered_map<FunctionID, FunctionProfile> profile;
+    std::unique_ptr<CallingContextTree> cct;
+    std::unique_ptr<FlightRecorder> flight;
+    std::unique_ptr<ReturnRecorder> returns;
+    // Per-assembly exclusive time (SW2TRACER_ASSEMBLY_TIME), indexed by assembly index.
+    std::vector<AssemblyTime> assemblyTime;
 
     void EnsureInit()
     {
@@ -97,36 +343,234 @@ private:
   static constexpr size_t kThreadBuckets = 64;
   std::array<ThreadBucket, kThreadBuckets> m_threadBuckets;
 
+  SW2TracerStats m_retiredStats{};
+  std::unordered_map<FunctionID, FunctionProfile> m_retiredProfile;
+  std::unique_ptr<CallingContextTree> m_retiredCct;
+  mutable std::mutex m_retiredStatsMutex;
+
+  // Periodic checkpointer (SW2TRACER_CHECKPOINT_MS). Generations last written per thread are
+  // only touched under m_checkpointWriteMutex.
+  std::thread m_checkpointThread;
+  std::mutex m_checkpointMutex;
+  std::condition_variable m_checkpointWake;
+  bool m_checkpointStop = false;
+  std::mutex m_checkpointWriteMutex;
+  std::unordered_map<ThreadID, uint64_t> m_checkpointGenerations;
+
+  // Hang watchdog. Everything the hooks contribute is the generation bump and enterGeneration;
+  // the poller compares them against what it saw on earlier polls.
+  struct WatchedThread
+  {
+    uint32_t thresholdMs = 0;
+    // Frames at this index and above were called from the registering frame; each must return
+    // within thresholdMs.
+    size_t baseDepth = 0;
+    uint64_t generation = 0;
+    std::chrono::steady_clock::time_point lastProgress;
+    // Per stack index: enterGeneration of the frame there and when the poller first saw it.
+    std::vector<std::pair<uint64_t, std::chrono::steady_clock::time_point>> frameSeen;
+    bool reported = false;
+  };
+  std::thread m_watchdogThread;
+  std::mutex m_watchdogMutex;
+  std::condition_variable m_watchdogWake;
+  bool m_watchdogStop = false;
+  std::unordered_map<ThreadID, WatchedThread> m_watchedThreads;
+  std::atomic<uint64_t> m_watchdogReports{0};
+  void PollWatchedThreads();
+
+  // Slow-call log (SW2TRACER_SLOW_CALL_US / SW2TRACER_SLOW_CALL_FILTER); null when disabled.
+  // Filter patterns are parsed once in SetConfig into thresholds in TSC cycles.
+  std::unique_ptr<SlowCallLog> m_slowCalls;
+  std::vector<std::pair<std::string, uint64_t>> m_slowCallRules;
+  uint64_t m_slowCallDefaultCycles = UINT64_MAX;
+  uint64_t SlowCallCyclesFor(const std::string &methodSignature) const;
+  void RecordSlowCall(const ThreadStackState &state, uint64_t now);
+  void WriteSlowCalls(std::ostream &out) const;
+
+  // Sampled allocations (SW2TRACER_ALLOC), keyed by the top frame at the sample and the type.
+  // Samples arrive about once per 100 KB allocated, so one mutex is enough. The type is its
+  // interned name rather than its ClassID: each reload of a collectible context brings new
+  // ClassIDs for the same types, and sites without an evictable frame (no managed frame, host
+  // code) would otherwise gain a key per reload.
+  struct AllocationSite
+  {
+    FunctionID functionId;
+    const char *typeName;
+    bool operator==(const AllocationSite &other) const { return functionId == other.functionId && typeName == other.typeName; }
+  };
+  struct AllocationSiteHash
+  {
+    size_t operator()(const AllocationSite &site) const
+    {
+      return std::hash<uint64_t>()(static_cast<uint64_t>(site.functionId) * 0x9E3779B97F4A7C15ull ^ reinterpret_cast<uintptr_t>(site.typeName));
+    }
+  };
+  struct AllocationTotals
+  {
+    uint64_t samples = 0;
+    uint64_t bytes = 0;
+  };
+  mutable std::mutex m_allocationsMutex;
+  std::unordered_map<AllocationSite, AllocationTotals, AllocationSiteHash> m_allocations;
+  // By assembly name at sample time, so totals survive the unload of the allocating code.
+  std::unordered_map<std::string, AllocationTotals> m_allocationsByAssembly;
+  AllocationTotals m_allocationTotals;
+  // Names that outlive the code they describe, including those handed out through the query
+  // API; never shrinks.
+  StringInterner m_internedNames;
+  void WriteAllocations(std::ostream &out) const;
+
+  // GC pause tracking (SW2TRACER_GC). Suspend and resume callbacks are serialized by the runtime;
+  // the mutex orders them against dumps and GetStats.
+  struct GcTriggerTotals
+  {
+    uint64_t collections = 0;
+    uint64_t pauseCycles = 0;
+  };
+  mutable std::mutex m_gcMutex;
+  std::unique_ptr<GcPauseRecorder> m_gcPauses;
+  GcPauseRecord m_pendingGc{};
+  bool m_gcPending = false;
+  uint64_t m_gcPauseCount = 0;
+  uint64_t m_gcPauseTotalCycles = 0;
+  uint64_t m_gcPauseMaxCycles = 0;
+  uint64_t m_gcPauseHistogram[kGcPauseHistogramBuckets] = {};
+  // Distinct triggering stacks are capped; stacks first seen past the cap are not aggregated.
+  static constexpr size_t kMaxGcTriggerStacks = 1024;
+  std::map<std::vector<FunctionID>, GcTriggerTotals> m_gcTriggerStacks;
+  void WriteGcPauses(std::ostream &out) const;
+
   size_t BucketIndex(ThreadID tid) const;
   ThreadStackState &GetOrCreateThreadState(ThreadID tid);
+  static void AccumulateStats(const ThreadStackState &state, SW2TracerStats &out);
+  // missedLeave: the frames' leaves were never reported, so they are dropped without the slow-call,
+  // timing and assembly-time accounting a real leave gets.
+  void PopFrames(ThreadStackState &state, size_t newSize, bool missedLeave = false);
+  void PopLeavingFrame(ThreadStackState &state, FunctionID functionId, UINT_PTR stackPointer);
+  void LeaveTopFrame(ThreadStackState &state);
+  void RecordFrameTiming(ThreadStackState &state, const StackFrame &frame, uint64_t inclusive);
+  std::vector<AssemblyTime> m_retiredAssemblyTime; // guarded by m_retiredStatsMutex
+  std::vector<std::pair<std::string, AssemblyTime>> CollectAssemblyTime() const;
+  void WriteAssemblyTime(std::ostream &out) const;
+  std::vector<std::pair<FunctionID, FunctionProfile>> CollectProfile() const;
+  const FunctionInfo *FindFunctionInfo(FunctionID id) const;
+  CallingContextTree CollectCallingContextTree() const;
+  // cpuNs is the thread's CPU time so far, or -1 when unknown.
+  void WriteThreadStack(std::ostream &out, ThreadID tid, DWORD osThreadId, const char *name, int64_t cpuNs, const std::vector<StackFrame> &frames, uint32_t overflowDepth, uint64_t now) const;
+  void WriteFlightEvents(std::ostream &out, const std::vector<FlightEvent> &events) const;
+  void RecordReturnValue(ThreadStackState &state, FunctionID functionId, COR_PRF_ELT_INFO eltInfo);
+  std::string FormatReturnValue(const ReturnRecord &record) const;
+  void WriteReturnValues(std::ostream &out, const std::vector<ReturnRecord> &records) const;
 
   void GetArgumentInfo(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, std::vector<std::string>& argumentInfo);
+  const MethodTokenInfo *GetOrReadMethodToken(ModuleID moduleId, mdMethodDef token);
+  const ModuleNames &GetOrReadModuleNames(ModuleID moduleId);
+  void RetireFunctionInfos(std::vector<std::pair<FunctionID, std::unique_ptr<FunctionInfo>>> evicted);
+  void ReclaimRetiredSymbols() const;
+  bool IsModuleUnloading(ModuleID moduleId) const;
 
 public:
+  ~StackManager();
+
   FunctionInfo BuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo);
-  const FunctionInfo* GetOrBuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo);
-  void FunctionEnter(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo);
-  void FunctionLeave(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo);
-  void FunctionTailcall(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo);
+  const FunctionInfo* GetOrBuildFunctionInfo(FunctionID id, COR_PRF_FRAME_INFO frameInfo, uint64_t *buildCycles = nullptr);
+  void FunctionEnter(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer = 0);
+  void FunctionLeave(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer = 0);
+  void FunctionTailcall(FunctionIDOrClientID id, COR_PRF_ELT_INFO eltInfo, UINT_PTR stackPointer = 0);
   void OnUnmanagedToManaged(FunctionID functionId, COR_PRF_TRANSITION_REASON reason);
+  void OnExceptionUnwindFunctionEnter(FunctionID functionId);
+  void OnExceptionUnwindFunctionLeave();
+  void OnFunctionUnloadStarted(FunctionID functionId);
+  void OnModuleUnloadStarted(ModuleID moduleId);
+  void OnModuleUnloadFinished(ModuleID moduleId);
+  void OnAssemblyUnloadFinished(AssemblyID assemblyId);
+  bool SetMode(TracerMode mode);
+  TracerMode GetMode() const;
+  void ResetAllStacks();
+  void SetConfig(const TracerConfig &config);
+  const TracerConfig &GetConfig() const;
   void SetCorProfilerInfo(ICorProfilerInfo15 *corProfilerInfo);
   ICorProfilerInfo15 *GetCorProfilerInfo();
 
   void OnThreadCreated(ThreadID threadId);
   void OnThreadDestroyed(ThreadID threadId);
   void OnThreadAssignedToOSThread(ThreadID managedThreadId, DWORD osThreadId);
+  void OnThreadNameChanged(ThreadID threadId, const WCHAR *name, ULONG nameLength);
+  // One AllocationTick sample: `bytes` allocated on threadId since its previous sample, the
+  // last object being of type typeName.
+  void OnAllocationSample(ThreadID threadId, const std::basic_string<WCHAR> &typeName, uint64_t bytes);
+  void OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON reason);
+  void OnRuntimeSuspendAborted();
+  void OnRuntimeResumeFinished();
+  // From the GCStart event: the runtime's GC index, condemned generation and GC reason.
+  void OnGcStart(uint32_t gcIndex, uint32_t generation, uint32_t reason);
   struct ThreadStackSnapshot
   {
     ThreadID threadId = 0;
     DWORD osThreadId = 0;
+    const char *name = "";
     uint32_t desyncNotFound = 0;
     uint32_t desyncFoundNotTop = 0;
     uint32_t tailcallPops = 0;
+    uint32_t exceptionUnwindPops = 0;
+    uint32_t overflowDepth = 0;
     std::vector<StackFrame> frames;
   };
 
+  // Keeps FunctionInfos evicted by a concurrent unload alive until it closes. Every dump opens
+  // one; callers of SnapshotAllStacks need one while they use the frames' functionInfo. The last
+  // scope to close frees what was retired meanwhile, unless opened with reclaim false: then that
+  // waits for the next unload or reclaiming scope, and closing the scope frees nothing.
+  class SymbolReadScope
+  {
+  public:
+    explicit SymbolReadScope(const StackManager &manager, bool reclaim = true) : m_manager(manager), m_reclaim(reclaim)
+    {
+      m_manager.m_symbolReaders.fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~SymbolReadScope()
+    {
+      if (m_manager.m_symbolReaders.fetch_sub(1, std::memory_order_seq_cst) == 1 && m_reclaim)
+        m_manager.ReclaimRetiredSymbols();
+    }
+    SymbolReadScope(const SymbolReadScope &) = delete;
+    SymbolReadScope &operator=(const SymbolReadScope &) = delete;
+
+  private:
+    const StackManager &m_manager;
+    bool m_reclaim;
+  };
+
   std::vector<ThreadStackSnapshot> SnapshotAllStacks() const;
+  void GetStats(SW2TracerStats &out) const;
   void Dump(std::string path) const;
+  void WriteDump(std::ostream &out) const;
+  // Watches the calling thread: a hang report is written when it makes no progress for
+  // thresholdMs, or when a method it calls from the current frame stays active that long.
+  // thresholdMs 0 stops watching it. Returns false when the thread is unknown.
+  bool WatchCurrentThread(uint32_t thresholdMs);
+  void StopWatchdog();
+  // Copies the stack of tid (0 for the calling thread) into frames, innermost first, without
+  // allocating. Returns how many frames were written; *depth, when given, receives the full depth
+  // including frames past maxFrames and above the depth cap. An unknown thread has depth 0.
+  size_t GetStack(ThreadID tid, SW2TracerFrame *frames, size_t maxFrames, size_t *depth) const;
+  // Names of a function seen by the hooks; false when it was never entered or has been unloaded.
+  bool LookupFunction(FunctionID functionId, SW2TracerFrame &frame) const;
+  // Busiest assemblies first; returns how many entries were written.
+  size_t GetAssemblyTime(SW2TracerAssemblyTime *entries, size_t maxEntries) const;
+  // Most recent slow calls first; returns how many were written to calls.
+  size_t GetSlowCalls(SW2TracerSlowCall *calls, size_t maxCalls) const;
+  // Starts the background checkpointer if the config asks for one; StopCheckpoints joins it.
+  void StartCheckpoints();
+  void StopCheckpoints();
+  // One checkpoint pass: rewrites (temp file + rename) the file of every thread whose stack
+  // changed and removes those of exited threads. Returns the number of thread files written.
+  size_t WriteCheckpoint();
+  // Collapsed-stack lines ("a;b;c weight") as consumed by flamegraph.pl / speedscope.
+  void DumpCollapsedStacks(std::string path, bool weightByTime) const;
+  // Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev) built from the flight recorders.
+  void DumpTrace(std::string path, size_t maxEventsPerThread) const;
 };
 
 StackManager* GlobalStackManager();
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Append-only string pool. Intern returns a NUL-terminated copy that is shared by equal strings
+// and never freed, so the pointer can be handed to callers outside the tracer (SW2TracerGetStack)
+// and read without any lock. Strings are packed into fixed-size chunks; the pool only grows with
+// distinct names, so reloading the same plugin adds nothing.
+class StringInterner
+{
+public:
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  const char *Intern(std::string_view text)
+  {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = m_strings.find(text);
+    if (it != m_strings.end())
+      return it->data();
+
+    char *copy = Allocate(text.size() + 1);
+    std::memcpy(copy, text.data(), text.size());
+    copy[text.size()] = '\0';
+    m_strings.insert(std::string_view(copy, text.size()));
+    return copy;
+  }
+
+private:
+  char *Allocate(size_t bytes)
+  {
+    // Oversized strings get a chunk of their own and leave the current one open.
+    if (bytes > kChunkBytes / 4)
+    {
+      m_chunks.push_back(std::make_unique<char[]>(bytes));
+      return m_chunks.back().get();
+    }
+    if (m_current == nullptr || m_used + bytes > kChunkBytes)
+    {
+      m_chunks.push_back(std::make_unique<char[]>(kChunkBytes));
+      m_current = m_chunks.back().get();
+      m_used = 0;
+    }
+    char *out = m_current + m_used;
+    m_used += bytes;
+    return out;
+  }
+
+  std::mutex m_mutex;
+  std::unordered_set<std::string_view> m_strings;
+  std::vector<std::unique_ptr<char[]>> m_chunks;
+  char *m_current = nullptr;
+  size_t m_used = 0;
+};
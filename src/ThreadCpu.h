@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// CPU time (user + kernel) consumed so far by the OS thread osThreadId of this process, in
+// nanoseconds, or -1 when it cannot be read. Called per thread at dump time, never from hooks.
+inline int64_t ThreadCpuNanoseconds(uint32_t osThreadId)
+{
+  if (osThreadId == 0)
+    return -1;
+#if defined(_WIN32)
+  HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, osThreadId);
+  if (thread == NULL)
+    return -1;
+  FILETIME creation, exit, kernel, user;
+  BOOL ok = GetThreadTimes(thread, &creation, &exit, &kernel, &user);
+  CloseHandle(thread);
+  if (!ok)
+    return -1;
+  auto hundredNs = [](const FILETIME &t) { return (static_cast<int64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+  return (hundredNs(kernel) + hundredNs(user)) * 100;
+#elif defined(__linux__)
+  // The clock pthread_getcpuclockid would return, built from the kernel thread id instead of a
+  // pthread_t (CPUCLOCK_SCHED of a single thread): one syscall, nanosecond resolution.
+  const clockid_t clock = static_cast<clockid_t>((~osThreadId << 3) | 6u);
+  timespec ts{};
+  if (clock_gettime(clock, &ts) == 0)
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+
+  // utime and stime are fields 14 and 15 of the stat line; the command name before them is in
+  // parentheses and may contain spaces.
+  std::ifstream stat("/proc/self/task/" + std::to_string(osThreadId) + "/stat");
+  std::string line;
+  if (!std::getline(stat, line))
+    return -1;
+  const size_t close = line.rfind(')');
+  if (close == std::string::npos)
+    return -1;
+  std::istringstream fields(line.substr(close + 1));
+  std::string skipped;
+  for (int i = 3; i < 14; i++)
+    fields >> skipped;
+  int64_t utime = 0, stime = 0;
+  if (!(fields >> utime >> stime))
+    return -1;
+  const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+  return ticksPerSecond > 0 ? (utime + stime) * (1000000000 / ticksPerSecond) : -1;
+#else
+  return -1;
+#endif
+}
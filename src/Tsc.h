@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+inline uint64_t ReadTsc()
+{
+  return __rdtsc();
+}
+
+// Calibrated once against steady_clock; call early (Initialize) so dumps never pay the sleep.
+inline double TscTicksPerNanosecond()
+{
+  static const double ticksPerNs = []() {
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = ReadTsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    uint64_t c1 = ReadTsc();
+    auto t1 = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    if (ns <= 0 || c1 <= c0)
+      return 1.0;
+    return (double)(c1 - c0) / (double)ns;
+  }();
+  return ticksPerNs;
+}
+
+inline uint64_t TscToNanoseconds(uint64_t ticks)
+{
+  return (uint64_t)((double)ticks / TscTicksPerNanosecond());
+}
+
+inline uint64_t NanosecondsToTsc(uint64_t ns)
+{
+  return (uint64_t)((double)ns * TscTicksPerNanosecond());
+}
@@ -4,6 +4,12 @@ EXTERN TailcallStub:PROC
 
 _text SEGMENT PARA 'CODE'
 
+; The stubs pass RSP as it was before the call into them (home space, three pushes and the
+; return address above us) as a third argument. Across enters the value orders frames by depth.
+; It is not known to match between the enter and the leave of one activation (with
+; COR_PRF_ELT_INFO the runtime calls us from its own ProfileEnter/ProfileLeave frames), so
+; StackManager only uses it to tell apart activations of the same FunctionID.
+
 ALIGN 16
 PUBLIC EnterNaked
 
@@ -21,6 +27,7 @@ EnterNaked PROC FRAME
 
     .ENDPROLOG
 
+    LEA R8, [RSP + 40H]
     CALL EnterStub
 
     ADD RSP, 20H
@@ -50,6 +57,7 @@ LeaveNaked PROC FRAME
 
     .ENDPROLOG
 
+    LEA R8, [RSP + 40H]
     CALL LeaveStub
 
     ADD RSP, 20H
@@ -79,6 +87,7 @@ TailcallNaked PROC FRAME
 
     .ENDPROLOG
 
+    LEA R8, [RSP + 40H]
     CALL TailcallStub
 
     ADD RSP, 20H
@@ -5,6 +5,24 @@ set_optimize("aggressive")
 
 local DOTNET_PATH = os.getenv("DOTNET_PATH")
 
+function add_coreclr_headers()
+    if is_plat("windows") then
+        add_defines("WIN32")
+        add_defines("_WIN32")
+    else 
+        add_defines("HOST_AMD64")
+    end
+
+    add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/prebuilt/inc"))
+    if is_plat("linux") then
+        add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/inc"))
+        add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/inc/rt"))
+    end
+    add_includedirs(path.join(DOTNET_PATH, "src/coreclr/inc"))
+    add_includedirs(path.join(DOTNET_PATH, "src/coreclr"))
+    add_includedirs(path.join(DOTNET_PATH, "src/native"))
+end
+
 target("sw2tracer")
     set_kind("shared")
     set_languages("cxx23")
@@ -20,21 +38,48 @@ target("sw2tracer")
         add_files("src/asm/systemv/*")
     end
 
-    if is_plat("windows") then
-        add_defines("WIN32")
-        add_defines("_WIN32")
-    else 
-        add_defines("HOST_AMD64")
-    end
+    add_coreclr_headers()
 
-    add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/prebuilt/inc"))
-    if is_plat("linux") then
-        add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/inc"))
-        add_includedirs(path.join(DOTNET_PATH, "src/coreclr/pal/inc/rt"))
+-- Drives StackManager through a fake ICorProfilerInfo15; no .NET runtime needed.
+-- xmake build sw2tracer_bench && xmake run sw2tracer_bench --threads 8
+target("sw2tracer_bench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx23")
+    set_arch("x64")
+    add_files("bench/TracerBench.cpp")
+    add_files("src/StackManager.cpp")
+    add_headerfiles("bench/*.h")
+    add_includedirs("src")
+
+    if not is_plat("windows") then
+        add_syslinks("pthread")
     end
-    add_includedirs(path.join(DOTNET_PATH, "src/coreclr/inc"))
-    add_includedirs(path.join(DOTNET_PATH, "src/coreclr"))
-    add_includedirs(path.join(DOTNET_PATH, "src/native"))
 
+    add_coreclr_headers()
+
+option("fuzz")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build sw2tracer_sigbench as a libFuzzer target (clang only)")
+option_end()
 
+-- Checks and times the signature parser in Helper.h against synthetic metadata.
+-- xmake build sw2tracer_sigbench && xmake run sw2tracer_sigbench --fuzz 100000
+-- xmake f --toolchain=clang --fuzz=y builds a libFuzzer binary instead.
+target("sw2tracer_sigbench")
+    set_kind("binary")
+    set_default(false)
+    set_languages("cxx23")
+    set_arch("x64")
+    add_files("bench/SigBench.cpp")
+    add_headerfiles("bench/*.h")
+    add_includedirs("src")
+
+    if has_config("fuzz") then
+        add_defines("SW2TRACER_FUZZ")
+        add_cxflags("-fsanitize=fuzzer,address")
+        add_ldflags("-fsanitize=fuzzer,address")
+    end
 
+    add_coreclr_headers()